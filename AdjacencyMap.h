@@ -0,0 +1,213 @@
+#pragma once
+
+#include "config.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace MSCSC {
+
+    // adjacency of one reduced graph node: key (neighbor id) -> SuperEdge*
+    // up to ADJ_SMALL_SIZE entries are kept in a flat array and scanned linearly,
+    // above that the same array becomes an open-addressing hash table (linear probing, backward-shift erase)
+    class AdjacencyMap {
+    public:
+        struct Entry {
+            int first; // neighbor id, EMPTY for a free hash slot
+            SuperEdge* second;
+        };
+
+        class iterator {
+        public:
+            iterator(Entry* now, Entry* end) : now(now), end(end) { Skip(); }
+
+            Entry& operator*() const { return *now; }
+            Entry* operator->() const { return now; }
+            iterator& operator++() { now++; Skip(); return *this; }
+            bool operator==(const iterator& other) const { return now == other.now; }
+            bool operator!=(const iterator& other) const { return now != other.now; }
+
+        private:
+            void Skip() {
+                while (now != end && now->first == EMPTY) {
+                    now++;
+                }
+            }
+
+            Entry* now;
+            Entry* end;
+        };
+
+        AdjacencyMap() = default;
+
+        ~AdjacencyMap() {
+            free(entries);
+        }
+
+        AdjacencyMap(const AdjacencyMap&) = delete;
+        AdjacencyMap& operator=(const AdjacencyMap&) = delete;
+
+        AdjacencyMap(AdjacencyMap&& other) noexcept : entries(other.entries), num(other.num), capacity(other.capacity) {
+            other.entries = nullptr;
+            other.num = other.capacity = 0;
+        }
+
+        AdjacencyMap& operator=(AdjacencyMap&& other) noexcept {
+            std::swap(entries, other.entries);
+            std::swap(num, other.num);
+            std::swap(capacity, other.capacity);
+            return *this;
+        }
+
+        iterator begin() { return iterator(entries, entries + Limit()); }
+        iterator end() { return iterator(entries + Limit(), entries + Limit()); }
+
+        size_t size() const { return num; }
+        bool empty() const { return num == 0; }
+
+        iterator find(int key) {
+            Entry* entry = Lookup(key);
+            return entry ? iterator(entry, entries + Limit()) : end();
+        }
+
+        // insert key with a nullptr value if it does not exist
+        SuperEdge*& operator[](int key) {
+            Entry* entry = Lookup(key);
+            if (entry) {
+                return entry->second;
+            }
+
+            if (num + 1 > (IsHash() ? capacity / 2 : capacity)) {
+                Grow();
+            }
+
+            num++;
+            if (!IsHash()) {
+                entries[num-1] = {key, nullptr};
+                return entries[num-1].second;
+            }
+
+            Entry* slot = HashInsert(key);
+            return slot->second;
+        }
+
+        void erase(int key) {
+            Entry* entry = Lookup(key);
+            if (!entry) {
+                return;
+            }
+
+            num--;
+            if (!IsHash()) { // swap with the last entry
+                *entry = entries[num];
+                return;
+            }
+
+            HashErase(entry - entries);
+
+            if (num <= ADJ_SMALL_SIZE / 2) { // back to the flat array
+                Rebuild(ADJ_SMALL_SIZE);
+            }
+        }
+
+    private:
+        static constexpr int EMPTY = -1;
+
+        bool IsHash() const { return capacity > ADJ_SMALL_SIZE; }
+
+        unsigned Limit() const { return IsHash() ? capacity : num; }
+
+        unsigned Home(int key) const {
+            unsigned h = (unsigned) key * 0x9E3779B1u;
+            return (h ^ (h >> 16)) & (capacity - 1);
+        }
+
+        Entry* Lookup(int key) {
+            if (!IsHash()) {
+                for (unsigned i=0;i<num;i++) {
+                    if (entries[i].first == key) {
+                        return &entries[i];
+                    }
+                }
+                return nullptr;
+            }
+
+            for (unsigned i=Home(key);;i=(i+1)&(capacity-1)) {
+                if (entries[i].first == key) {
+                    return &entries[i];
+                }
+                if (entries[i].first == EMPTY) {
+                    return nullptr;
+                }
+            }
+        }
+
+        Entry* HashInsert(int key) {
+            unsigned i = Home(key);
+            while (entries[i].first != EMPTY) {
+                i = (i + 1) & (capacity - 1);
+            }
+            entries[i] = {key, nullptr};
+            return &entries[i];
+        }
+
+        void HashErase(unsigned hole) {
+            unsigned mask = capacity - 1;
+            for (unsigned j=(hole+1)&mask;entries[j].first!=EMPTY;j=(j+1)&mask) {
+                unsigned home = Home(entries[j].first);
+                // move j into the hole if its home is not in the cyclic range (hole, j]
+                if (((j - home) & mask) >= ((j - hole) & mask)) {
+                    entries[hole] = entries[j];
+                    hole = j;
+                }
+            }
+            entries[hole].first = EMPTY;
+        }
+
+        void Grow() {
+            if (capacity == 0) {
+                Rebuild(ADJ_INIT_SIZE);
+            } else if (!IsHash() && capacity < ADJ_SMALL_SIZE) {
+                Rebuild(capacity * 2 < ADJ_SMALL_SIZE ? capacity * 2 : ADJ_SMALL_SIZE);
+            } else {
+                Rebuild(capacity < ADJ_SMALL_SIZE * 4 ? ADJ_SMALL_SIZE * 4 : capacity * 2);
+            }
+        }
+
+        // move all entries into a new array of newCapacity slots
+        void Rebuild(unsigned newCapacity) {
+            Entry* oldEntries = entries;
+            unsigned oldLimit = Limit();
+
+            entries = (Entry*) malloc(sizeof(Entry) * newCapacity);
+            capacity = newCapacity;
+
+            if (IsHash()) {
+                for (unsigned i=0;i<capacity;i++) {
+                    entries[i].first = EMPTY;
+                }
+                for (unsigned i=0;i<oldLimit;i++) {
+                    if (oldEntries[i].first != EMPTY) {
+                        HashInsert(oldEntries[i].first)->second = oldEntries[i].second;
+                    }
+                }
+            } else {
+                unsigned index = 0;
+                for (unsigned i=0;i<oldLimit;i++) {
+                    if (oldEntries[i].first != EMPTY) {
+                        entries[index++] = oldEntries[i];
+                    }
+                }
+            }
+
+            free(oldEntries);
+        }
+
+    private:
+        Entry* entries = nullptr;
+        unsigned num = 0;
+        unsigned capacity = 0; // <= ADJ_SMALL_SIZE: flat array, otherwise a power of two hash table
+    };
+
+}
@@ -1,6 +1,9 @@
 #include "ReducedGraph.h"
+#include "binaryio.h"
 
 #include <algorithm>
+#include <numeric>
+#include <array>
 #include <queue>
 #include <random>
 #include <stack>
@@ -14,32 +17,50 @@ namespace MSCSC {
         GOut.resize(n+1);
         GIn.resize(n+1);
 
+        auto& edges = tarjan->edges;
         for (int i=0;i<=originalN;i++) {
             auto& edgeList = tarjan->G[i];
             int s = tarjan->Find(i);
             for (auto edge : edgeList) {
-                int t = tarjan->Find(edge->t);
+                int t = tarjan->Find(edges.t[edge]);
 
                 if (s != t) { // external edge
-                    edge->needed = false; // !!!??? todo todo update new edge
+                    edges.SetNeeded(edge, false); // !!!??? todo todo update new edge
 
-                    if (GOut[s].find(t) != GOut[s].end()) { 
-                        auto targetEdge = GOut[s][t];
-                        targetEdge->subEdge.emplace(edge);
+                    auto it = GOut[s].find(t);
+                    if (it != GOut[s].end()) {
+                        auto targetEdge = it->second;
+                        targetEdge->AddSubEdge(edges, edge);
                     } else { // create new edge
-                        auto newEdge = new SuperEdge(s, t);
-                        newEdge->subEdge.emplace(edge);
+                        auto newEdge = superEdgePool.New(s, t);
+                        newEdge->AddSubEdge(edges, edge);
                         GOut[s][t] = newEdge;
                         GIn[t][s] = newEdge;
                     }
                 } else { // internal edge
-                    edge->internal = true;
+                    edges.SetInternal(edge, true);
 
-                    tarjan->necEdgeNumMap[s]++;
+                    tarjan->necEdgeNumMap[s] += edges.Needed(edge);
                 }
             }
+            tarjan->PartitionEdges(i);
         }
+        tarjan->CountInternalEdge();
         
+        ResizeScratch();
+        BuildOrder();
+        BuildLabel();
+    }
+
+    ReducedGraph::~ReducedGraph() {
+        for (auto& edgeMap : GOut) {
+            for (auto& [key, edge] : edgeMap) {
+                superEdgePool.Delete(edge);
+            }
+        }
+    }
+
+    void ReducedGraph::ResizeScratch() {
         state.resize(n+1, 0);
 
         // parameter
@@ -48,57 +69,543 @@ namespace MSCSC {
         dfn_.resize(n+1, 0);
         low_.resize(n+1, 0);
         visited_.reserve(n+1);
+
+        ord.resize(n+1, 0);
+        orderMark.resize(n+1, 0);
+
+        forwardParent.resize(n+1, nullptr);
+        backwardParent.resize(n+1, nullptr);
+        reachLabel.resize((n+1) * REACH_LABEL_NUM);
+    }
+
+    void ReducedGraph::Extend() {
+        if (originalN != tarjan->n) { // tarjan added vertex slots and moved its scc ids up
+            Remap();
+            return;
+        }
+
+        if (extendN == tarjan->extendN) {
+            return;
+        }
+
+        int oldN = n;
+        extendN = tarjan->extendN;
+        n = originalN + 1 + extendN;
+
+        GOut.resize(n+1);
+        GIn.resize(n+1);
+        ResizeScratch();
+
+        for (int i=oldN+1;i<=n;i++) { // no edges yet, so any position after the old nodes keeps the order
+            ord[i] = i;
+        }
     }
 
-    bool ReducedGraph::MayMergeDFS(int s, int t, int now, IncOutput& output, vector<int>& visited) {
-        visited.emplace_back(now);
-        state[now] = 1;
+    void ReducedGraph::Remap() {
+        int oldN = originalN;
+        int num = tarjan->n - oldN;
+        auto shift = [&](int x) { return x > oldN ? x + num : x; };
+
+        vector<SuperEdge*> edgeList;
+        for (auto& edgeMap : GOut) {
+            for (auto& [key, edge] : edgeMap) {
+                edgeList.emplace_back(edge);
+            }
+        }
+
+        originalN = tarjan->n;
+        extendN = tarjan->extendN;
+        n = originalN + 1 + extendN;
+
+        GOut.clear();
+        GIn.clear();
+        GOut.resize(n+1);
+        GIn.resize(n+1);
+        for (auto edge : edgeList) {
+            edge->s = shift(edge->s);
+            edge->t = shift(edge->t);
+            GOut[edge->s][edge->t] = edge;
+            GIn[edge->t][edge->s] = edge;
+        }
+
+        // the scratch arrays are indexed by id, start them over
+        state.clear();
+        sccMap.clear();
+        inStack_.clear();
+        dfn_.clear();
+        low_.clear();
+        ord.clear();
+        orderMark.clear();
+        forwardParent.clear();
+        backwardParent.clear();
+        reachLabel.clear();
+
+        ResizeScratch();
+        BuildOrder();
+        BuildLabel();
+    }
 
-        if (now == s) {
-            state[now] = 2;
-            output.affNode.emplace(now);
+    void ReducedGraph::BuildOrder() {
+        // kahn
+        vector<int> inDegree(n+1);
+        vector<int> queue;
+        queue.reserve(n+1);
+
+        for (int i=0;i<=n;i++) {
+            inDegree[i] = GIn[i].size();
+            if (!inDegree[i]) {
+                queue.emplace_back(i);
+            }
+        }
+
+        for (int head=0;head<(int) queue.size();head++) {
+            int x = queue[head];
+            ord[x] = head;
+
+            for (auto& [t, edge] : GOut[x]) {
+                if (!--inDegree[t]) {
+                    queue.emplace_back(t);
+                }
+            }
+        }
+
+        orderValid = (int) queue.size() == n + 1;
+        orderCycle = false;
+        if (!orderValid) { // nodes on a cycle still need a position
+            int next = queue.size();
+            for (int i=0;i<=n;i++) {
+                if (inDegree[i]) {
+                    ord[i] = next++;
+                }
+            }
+        }
+    }
+
+    void ReducedGraph::UpdateOrder(int s, int t) {
+        if (!orderValid) {
+            orderCycle = false; // this edge is not in the order either
+            return;
+        }
+        if (ord[s] < ord[t]) {
+            return;
+        }
+
+        int lowerBound = ord[t];
+        int upperBound = ord[s];
+        bool cycle = false;
+
+        // nodes reachable from t inside the window
+        orderStack.emplace_back(t);
+        orderMark[t] = ORDER_FORWARD;
+        while (!orderStack.empty()) {
+            int x = orderStack.back();
+            orderStack.pop_back();
+            orderForward.emplace_back(x);
+
+            for (auto& [v, edge] : GOut[x]) {
+                if (v == s) {
+                    cycle = true;
+                    continue;
+                }
+                if (!orderMark[v] && ord[v] < upperBound) {
+                    orderMark[v] = ORDER_FORWARD;
+                    orderStack.emplace_back(v);
+                }
+            }
+        }
+
+        // a cycle runs through s and t, so t reaches s and s is reached from t
+        if (cycle) {
+            orderMark[s] = ORDER_FORWARD;
+            orderForward.emplace_back(s);
+            orderMark[t] |= ORDER_BACKWARD;
+        }
+
+        // nodes reaching s inside the window
+        orderStack.emplace_back(s);
+        orderMark[s] |= ORDER_BACKWARD;
+        while (!orderStack.empty()) {
+            int x = orderStack.back();
+            orderStack.pop_back();
+            orderBackward.emplace_back(x);
+
+            for (auto& [v, edge] : GIn[x]) {
+                if (!(orderMark[v] & ORDER_BACKWARD) && ord[v] > lowerBound) {
+                    orderMark[v] |= ORDER_BACKWARD;
+                    orderStack.emplace_back(v);
+                }
+            }
+        }
+
+        // the backward nodes take the smallest positions of both sets, then the nodes of the cycle, then the forward nodes,
+        // each keeping their own relative order; only the edges inside the cycle are left against the order
+        auto byOrder = [&](int a, int b) { return ord[a] < ord[b]; };
+        auto& nodeList = orderNode;
+        auto take = [&](vector<int>& list, char mark) {
+            size_t first = nodeList.size();
+            for (auto x : list) {
+                if (orderMark[x] == mark) {
+                    nodeList.emplace_back(x);
+                    orderStack.emplace_back(ord[x]);
+                }
+            }
+            sort(nodeList.begin() + first, nodeList.end(), byOrder);
+        };
+
+        take(orderBackward, ORDER_BACKWARD);
+        take(orderForward, ORDER_FORWARD | ORDER_BACKWARD);
+        take(orderForward, ORDER_FORWARD);
+        sort(orderStack.begin(), orderStack.end());
+
+        for (int i=0;i<(int) nodeList.size();i++) {
+            ord[nodeList[i]] = orderStack[i];
+        }
+
+        for (auto x : orderForward) {
+            orderMark[x] = 0;
+        }
+        for (auto x : orderBackward) {
+            orderMark[x] = 0;
+        }
+
+        if (cycle) { // the scc merge that follows removes the cycle
+            orderValid = false;
+            orderCycle = true;
+        }
+
+        nodeList.clear();
+        orderStack.clear();
+        orderForward.clear();
+        orderBackward.clear();
+    }
+
+    void ReducedGraph::Serialize(FILE* file) {
+        BinaryIO::WriteValue(file, originalN);
+        BinaryIO::WriteValue(file, extendN);
+        BinaryIO::WriteValue(file, n);
+
+        // (s, t, subEdge size) of each super edge; the sub edges themselves follow from the scc nodes
+        vector<array<unsigned long long, 3>> edgeList;
+        for (auto& edgeMap : GOut) {
+            for (auto& [key, edge] : edgeMap) {
+                edgeList.push_back({(unsigned long long) edge->s, (unsigned long long) edge->t, edge->subEdge.size()});
+            }
+        }
+        BinaryIO::WriteVector(file, edgeList);
+    }
+
+    void ReducedGraph::Deserialize(FILE* file, Tarjan* tarjan_) {
+        tarjan = tarjan_;
+
+        BinaryIO::ReadValue(file, originalN);
+        BinaryIO::ReadValue(file, extendN);
+        BinaryIO::ReadValue(file, n);
+        BinaryIO::Check(originalN == tarjan->n && extendN == tarjan->extendN && n == originalN + 1 + extendN);
+
+        GOut.resize(n+1);
+        GIn.resize(n+1);
+
+        vector<array<unsigned long long, 3>> edgeList;
+        BinaryIO::ReadVector(file, edgeList);
+        for (auto [s, t, size] : edgeList) {
+            BinaryIO::Check(s <= (unsigned long long) n && t <= (unsigned long long) n);
+            BinaryIO::Check(GOut[s].find(t) == GOut[s].end()); // a second copy would leak the first super edge
+
+            auto newEdge = superEdgePool.New(s, t);
+            GOut[s][t] = newEdge;
+            GIn[t][s] = newEdge;
+        }
+
+        // every external edge belongs to the super edge between its two scc nodes
+        auto& edges = tarjan->edges;
+        for (int u=0;u<=tarjan->n;u++) {
+            for (int i=tarjan->internalNum[u];i<(int) tarjan->G[u].size();i++) {
+                auto edge = tarjan->G[u][i];
+                int s = tarjan->Find(edges.s[edge]);
+                int t = tarjan->Find(edges.t[edge]);
+                auto it = GOut[s].find(t);
+                BinaryIO::Check(it != GOut[s].end());
+                it->second->AddSubEdge(edges, edge);
+            }
+        }
+
+        for (auto [s, t, size] : edgeList) {
+            BinaryIO::Check(GOut[s][t]->subEdge.size() == size);
+        }
+
+        ResizeScratch();
+        BuildOrder(); // not stored in the checkpoint
+        BuildLabel();
+    }
+
+    void ReducedGraph::MayMerge(int s, int t, IncOutput& output) { // bidirectional search in a DAG
+        output.affNode.clear();
+        output.necEdge.clear();
+
+        if (!Meet(t, s)) {
+            ClearSearch();
+            return;
+        }
+
+        // finish the smaller side, then search from the other end inside it: exactly the nodes on a path from t to s
+        bool forward = searchForward_.size() <= searchBackward_.size();
+        auto& frontier = forward ? searchForward_ : searchBackward_;
+        while (!frontier.empty()) {
+            Expand(frontier, forward);
+        }
+
+        int done = forward ? SEARCH_FORWARD : SEARCH_BACKWARD;
+        int start = forward ? s : t;
+        auto& parent = forward ? backwardParent : forwardParent;
+        auto& nodeList = searchNext_;
+
+        nodeList.assign(1, start);
+        state[start] |= SEARCH_PATH;
+        parent[start] = nullptr;
+
+        for (int head=0;head<(int) nodeList.size();head++) {
+            int x = nodeList[head];
+            for (auto& [v, edge] : (forward ? GIn[x] : GOut[x])) {
+                if ((state[v] & done) && !(state[v] & SEARCH_PATH)) {
+                    state[v] |= SEARCH_PATH;
+                    parent[v] = edge;
+                    nodeList.emplace_back(v);
+                }
+            }
+        }
+
+        // an in-tree from t and an out-tree to s, an edge in both is kept once
+        for (int x : nodeList) {
+            output.affNode.emplace_back(x);
+
+            if (forwardParent[x]) {
+                output.necEdge.emplace_back(forwardParent[x]);
+            }
+
+            auto edge = backwardParent[x];
+            if (edge && forwardParent[edge->t] != edge) {
+                output.necEdge.emplace_back(edge);
+            }
+        }
+
+        ClearSearch();
+    }
+
+    bool ReducedGraph::Reachable(int s, int t) {
+        if (s == t) {
             return true;
-        } else {
-            bool result = false;
-
-            for (auto& [v, edge] : GOut[now]) {
-                if (state[v] == 0) { // unvisited
-                    if (MayMergeDFS(s, t, v, output, visited)) {
-                        result = true;
-                        output.necEdge.emplace_back(edge);
-                        state[now] = 2;
-                        output.affNode.emplace(now);
+        }
+
+        bool result = Meet(s, t);
+        ClearSearch();
+
+        return result;
+    }
+
+    bool ReducedGraph::Meet(int from, int to) {
+        if (!orderValid) {
+            BuildOrder();
+        }
+        if (orderValid && ord[from] > ord[to]) { // to comes first, no path
+            return false;
+        }
+
+        if (widenNum > n && orderValid) { // labels got loose, amortized over the widening
+            BuildLabel();
+        }
+        if (!LabelContains(from, to)) {
+            return false;
+        }
+
+        searchFrom_ = from;
+        searchTo_ = to;
+        searchForward_.assign(1, from);
+        searchBackward_.assign(1, to);
+        Mark(from, SEARCH_FORWARD, nullptr);
+        Mark(to, SEARCH_BACKWARD, nullptr);
+
+        // always expand the smaller frontier; once one side is exhausted without meeting, there is no path
+        bool meet = false;
+        while (!meet && !searchForward_.empty() && !searchBackward_.empty()) {
+            if (searchForward_.size() <= searchBackward_.size()) {
+                meet = Expand(searchForward_, true);
+            } else {
+                meet = Expand(searchBackward_, false);
+            }
+        }
+
+        return meet;
+    }
+
+    void ReducedGraph::Mark(int x, int flag, SuperEdge* edge) {
+        if (!state[x]) {
+            searchVisited_.emplace_back(x);
+        }
+        state[x] |= flag;
+        (flag == SEARCH_FORWARD ? forwardParent : backwardParent)[x] = edge;
+    }
+
+    bool ReducedGraph::Expand(vector<int>& frontier, bool forward) {
+        int flag = forward ? SEARCH_FORWARD : SEARCH_BACKWARD;
+        bool meet = false;
+
+        // the forward side only keeps nodes that may reach searchTo_, the backward side only nodes searchFrom_ may reach
+        int upperBound = orderValid ? ord[searchTo_] : n + 1;
+        int lowerBound = orderValid ? ord[searchFrom_] : -1;
+
+        auto& next = searchNext_;
+        next.clear();
+        for (int x : frontier) {
+            for (auto& [v, edge] : (forward ? GOut[x] : GIn[x])) {
+                if (state[v] & flag) {
+                    continue;
+                }
+                if (forward ? (ord[v] > upperBound || !LabelContains(v, searchTo_)) : (ord[v] < lowerBound || !LabelContains(searchFrom_, v))) {
+                    continue;
+                }
+
+                Mark(v, flag, edge);
+                meet |= (state[v] & (SEARCH_FORWARD | SEARCH_BACKWARD)) == (SEARCH_FORWARD | SEARCH_BACKWARD);
+                next.emplace_back(v);
+            }
+        }
+
+        frontier.swap(next);
+        return meet;
+    }
+
+    void ReducedGraph::ClearSearch() {
+        for (auto i : searchVisited_) {
+            state[i] = 0;
+        }
+        searchVisited_.clear();
+    }
+
+    void ReducedGraph::BuildLabel() {
+        // REACH_LABEL_NUM post-order dfs with shuffled roots: label = [lowest post-order below the node, its own post-order]
+        vector<int> rootList(n+1);
+        iota(rootList.begin(), rootList.end(), 0);
+        mt19937 generator(REACH_LABEL_NUM);
+
+        vector<char> visited(n+1);
+        vector<pair<int, AdjacencyMap::iterator>> frame;
+
+        for (int k=0;k<REACH_LABEL_NUM;k++) {
+            shuffle(rootList.begin(), rootList.end(), generator);
+            fill(visited.begin(), visited.end(), 0);
+            int postNum = 0;
+
+            for (int root : rootList) {
+                if (visited[root]) {
+                    continue;
+                }
+
+                visited[root] = 1;
+                reachLabel[root*REACH_LABEL_NUM+k].first = INF;
+                frame.push_back({root, GOut[root].begin()});
+
+                while (!frame.empty()) {
+                    int x = frame.back().first;
+                    auto& it = frame.back().second;
+
+                    if (it != GOut[x].end()) {
+                        int v = it->first;
+                        ++it;
+
+                        if (!visited[v]) {
+                            visited[v] = 1;
+                            reachLabel[v*REACH_LABEL_NUM+k].first = INF;
+                            frame.push_back({v, GOut[v].begin()});
+                        } else { // already finished in a DAG
+                            auto& label = reachLabel[x*REACH_LABEL_NUM+k];
+                            label.first = min(label.first, reachLabel[v*REACH_LABEL_NUM+k].first);
+                        }
+                        continue;
                     }
-                } else if (state[v] == 2) { // if its neighbor is valid, then it is valid too
-                    result = true;
-                    if (state[now] != 2) {
-                        output.necEdge.emplace_back(edge);
-                        state[now] = 2;
-                        output.affNode.emplace(now);
+
+                    auto& label = reachLabel[x*REACH_LABEL_NUM+k];
+                    label.second = ++postNum;
+                    label.first = min(label.first, label.second);
+
+                    frame.pop_back();
+                    if (!frame.empty()) {
+                        auto& parentLabel = reachLabel[frame.back().first*REACH_LABEL_NUM+k];
+                        parentLabel.first = min(parentLabel.first, label.first);
                     }
                 }
             }
+        }
+
+        widenNum = 0;
+    }
 
-            return result;
+    bool ReducedGraph::CheckLabel() {
+        for (int s=0;s<=n;s++) {
+            for (auto& [t, edge] : GOut[s]) {
+                if (!LabelContains(s, t)) {
+                    return false;
+                }
+            }
         }
+        return true;
     }
 
-    IncOutput ReducedGraph::MayMerge(int s, int t) { // DFS in a DAG
-        IncOutput output;
-        vector<int> visited; 
-        MayMergeDFS(s, t, t, output, visited);
-        for (auto i : visited) {
-            state[i] = 0;
+    bool ReducedGraph::LabelContains(int u, int v) {
+        for (int k=0;k<REACH_LABEL_NUM;k++) {
+            auto& outer = reachLabel[u*REACH_LABEL_NUM+k];
+            auto& inner = reachLabel[v*REACH_LABEL_NUM+k];
+            if (inner.first < outer.first || inner.second > outer.second) {
+                return false;
+            }
         }
+        return true;
+    }
 
-        return output;
+    void ReducedGraph::WidenLabel(int s, int t) {
+        // keep label(t) inside label(s) for the new edge (s, t), then for every ancestor
+        if (LabelContains(s, t)) {
+            return;
+        }
+
+        Include(s, t);
+        PropagateLabel(s);
+    }
+
+    void ReducedGraph::PropagateLabel(int u) {
+        auto& stack = searchNext_;
+        stack.assign(1, u);
+
+        while (!stack.empty()) {
+            int x = stack.back();
+            stack.pop_back();
+
+            for (auto& [p, edge] : GIn[x]) {
+                if (!LabelContains(p, x)) {
+                    Include(p, x);
+                    stack.emplace_back(p);
+                }
+            }
+        }
     }
 
-    IncOutput ReducedGraph::InsertionMinimum(EdgeNode* edge) {
+    void ReducedGraph::Include(int u, int v) {
+        widenNum++;
+        for (int k=0;k<REACH_LABEL_NUM;k++) {
+            auto& outer = reachLabel[u*REACH_LABEL_NUM+k];
+            auto& inner = reachLabel[v*REACH_LABEL_NUM+k];
+            outer.first = min(outer.first, inner.first);
+            outer.second = max(outer.second, inner.second);
+        }
+    }
+
+    void ReducedGraph::InsertionMinimum(int edge, IncOutput& output) {
         SingleInsertion(edge);
-        auto newEdge = GOut[tarjan->Find(edge->s)][tarjan->Find(edge->t)];
+        auto newEdge = GOut[tarjan->Find(tarjan->edges.s[edge])][tarjan->Find(tarjan->edges.t[edge])];
 
-        Args args(inStack_, dfn_, low_, visited_);
+        output.affNode.clear();
+        output.necEdge.clear();
+
+        auto& args = args_;
         auto& dfn = args.dfn;
 
         OnlyTarjan(newEdge->s, args); // enough
@@ -108,23 +615,30 @@ namespace MSCSC {
         //     }
         // }
 
-        IncOutput output;
-
-        for (int i=0;i<=n;i++) {
+        // only nodes the dfs visited can be merged
+        for (auto i : args.visited) {
             if (sccMap[i] != -1) {
-                output.affNode.emplace(i);
+                output.affNode.emplace_back(i);
             }
         }
 
         if (output.affNode.empty()) {
-            return output;
+            args.Reset();
+            return;
+        }
+
+        // the dfs is over, scratch: low = in-degree inside the new scc, inStack = reached from t
+        auto& inDegree = args.low;
+        auto& canReach = args.inStack;
+
+        for (auto i : output.affNode) {
+            inDegree[i] = 0;
         }
 
-        map<int, int> inDegreeMap;
         for (auto i : output.affNode) {
             for (auto e : GOut[i]) {
                 if (sccMap[e.first] != -1) {
-                    inDegreeMap[e.first]++;
+                    inDegree[e.first]++;
                 }
             }
         }
@@ -134,14 +648,11 @@ namespace MSCSC {
             int s = newEdge->s;
             int t = newEdge->t;
 
-            unordered_map<int, bool> canReach;
-
-            queue<int> q;
-            q.push(t);
+            auto& queue = searchNext_; // scratch, no search is running
+            queue.assign(1, t);
 
-            while (!q.empty()) {
-                int u = q.front();
-                q.pop();
+            for (int head=0;head<(int) queue.size();head++) {
+                int u = queue[head];
 
                 if (u == s) { // ignore the new edge(s, t)
                     continue;
@@ -153,12 +664,12 @@ namespace MSCSC {
                     int v = e.first;
                     if (sccMap[v] != -1) { // inside the new SCC
                         lastEdge = e.second;
-                        inDegreeMap[v]--;
-                        if (inDegreeMap[v] == 0) {
-                            q.push(v);
+                        inDegree[v]--;
+                        if (inDegree[v] == 0) {
+                            queue.emplace_back(v);
 
                             if (!canReach[v]) {
-                                canReach[v] = true;
+                                canReach[v] = 1;
                                 reachU = true;
                                 output.necEdge.emplace_back(e.second);
                             }
@@ -167,7 +678,7 @@ namespace MSCSC {
                 }
 
                 if (!reachU) { // just make the last valid edge as necessary
-                    canReach[lastEdge->t] = true;
+                    canReach[lastEdge->t] = 1;
                     output.necEdge.emplace_back(lastEdge);
                 }
             }
@@ -180,78 +691,80 @@ namespace MSCSC {
 
         output.necEdge.emplace_back(newEdge); // add the new edge
 
-        return output;
+        args.Reset();
     }
 
     void ReducedGraph::OnlyTarjan(int u, Args& args) {
-        auto& dfn = args.dfn;
-        auto& low = args.low;
-        auto& dfnNum = args.dfnNum;
-        auto& dfsStack = args.dfsStack;
-        auto& inStack = args.inStack;
-        auto& visited = args.visited;
+        BuildFrom(u, args, nullptr);
+    }
 
-        visited.emplace_back(u);
-        dfn[u] = low[u] = ++dfnNum;
-        dfsStack.push(u);
-        inStack[u] = 1;
+    void ReducedGraph::DeletionSCC(DecOutput& output) {
+        Extend();
 
-        for (auto [key, edge] : GOut[u]) {
-            int v = edge->t;
+        InheritLabel(output);
+        SplitEdges(output);
+    }
 
-            if (!dfn[v]) {
-                OnlyTarjan(v, args);
+    void ReducedGraph::DeletionSCC(vector<DecOutput>& outputList, int num) {
+        Extend();
 
-                if (low[v] <= low[u]) {
-                    low[u] = low[v];
-                }
-            } else if (inStack[v] && low[u] > dfn[v]) {
-                low[u] = dfn[v];
+        // an edge added for one split may point into the parts of a later one, so every part gets its label first
+        for (int i=0;i<num;i++) {
+            if (outputList[i].newNode.size() > 1) {
+                InheritLabel(outputList[i]);
             }
         }
 
-        if (low[u] == dfn[u]) {
-            while (dfsStack.top() != u) {
-                Merge(u, dfsStack.top());
-                inStack[dfsStack.top()] = 0;
-                dfsStack.pop();
+        for (int i=0;i<num;i++) {
+            if (outputList[i].newNode.size() > 1) {
+                SplitEdges(outputList[i]);
             }
+        }
+    }
 
-            inStack[u] = 0;
-            dfsStack.pop(); // s[tail] = u
+    void ReducedGraph::InheritLabel(DecOutput& output) {
+        // every part of the old scc reaches no more than it did, so the old label still holds
+        int sccID = output.sccID;
+        for (auto i : output.newNode) {
+            if (i != sccID) {
+                copy_n(reachLabel.begin() + sccID*REACH_LABEL_NUM, REACH_LABEL_NUM, reachLabel.begin() + i*REACH_LABEL_NUM);
+            }
         }
     }
 
-    void ReducedGraph::DeletionSCC(DecOutput& output) {
-        vector<SuperEdge*> deleteEdgeList; // edges in the 2-hop graph
-        vector<EdgeNode*> addEdgeList; // internal edge
+    void ReducedGraph::SplitEdges(DecOutput& output) {
+        auto& deleteEdgeList = deleteEdge_; // edges in the 2-hop graph
+        auto& addEdgeList = addEdge_; // internal edge
+        deleteEdgeList.clear();
+        addEdgeList.clear();
         int sccID = output.sccID;
+        auto& edges = tarjan->edges;
 
         // to find edges that should not be internal
         for (auto id : output.sccNodeList) {
-            for (auto edge : tarjan->G[id]) {
-                // previously internal
-                if (edge->internal) {
-                    if (tarjan->Find(edge->s) != tarjan->Find(edge->t)) {
-                        edge->internal = false;
-                        addEdgeList.emplace_back(edge);
-                    } else {
-                        tarjan->necEdgeNumMap[tarjan->Find(edge->s)]++;
-                    }
+            for (int i=0;i<tarjan->internalNum[id];) { // previously internal
+                auto edge = tarjan->G[id][i];
+                if (tarjan->Find(edges.s[edge]) != tarjan->Find(edges.t[edge])) {
+                    tarjan->SetInternalAt(id, i, false); // the last internal one is moved to i
+                    addEdgeList.emplace_back(edge);
+                } else {
+                    tarjan->necEdgeNumMap[tarjan->Find(edges.s[edge])] += edges.Needed(edge);
+                    i++;
                 }
             }
         }
 
         // external edge
         for (auto& [key, edge] : GOut[sccID]) {
-            for (auto it=edge->subEdge.begin();it!=edge->subEdge.end();) {
-                int s = tarjan->Find((*it)->s);
+            for (int i=0;i<(int) edge->subEdge.size();) {
+                auto subEdge = edge->subEdge[i];
+                int s = tarjan->Find(edges.s[subEdge]);
 
                 if (s != sccID) {
-                    addEdgeList.emplace_back(*it);
-                    it = edge->subEdge.erase(it);
+                    addEdgeList.emplace_back(subEdge);
+                    edge->RemoveSubEdge(edges, subEdge); // the last one is moved to i
                 } else {
-                    it++;
+                    i++;
                 }
             }
             
@@ -261,14 +774,15 @@ namespace MSCSC {
         }
 
         for (auto& [key, edge] : GIn[sccID]) {
-            for (auto it=edge->subEdge.begin();it!=edge->subEdge.end();) {
-                int t = tarjan->Find((*it)->t);
+            for (int i=0;i<(int) edge->subEdge.size();) {
+                auto subEdge = edge->subEdge[i];
+                int t = tarjan->Find(edges.t[subEdge]);
 
                 if (t != sccID) {
-                    addEdgeList.emplace_back(*it);
-                    it = edge->subEdge.erase(it);
+                    addEdgeList.emplace_back(subEdge);
+                    edge->RemoveSubEdge(edges, subEdge); // the last one is moved to i
                 } else {
-                    it++;
+                    i++;
                 }
             }
             
@@ -281,20 +795,21 @@ namespace MSCSC {
         for (auto edge : deleteEdgeList) {
             DeleteEdge(edge);
         }
-        
+
         // add edge
         for (auto edge : addEdgeList) {
-            int s = tarjan->Find(edge->s);
-            int t = tarjan->Find(edge->t);
+            int s = tarjan->Find(edges.s[edge]);
+            int t = tarjan->Find(edges.t[edge]);
 
             if (s == t) {
-                edge->internal = true;
+                tarjan->SetInternal(edge, true);
                 continue;
             }
 
-            if (GOut[s].find(t) != GOut[s].end()) {
-                auto newEdge = GOut[s][t];
-                newEdge->subEdge.emplace(edge);
+            auto it = GOut[s].find(t);
+            if (it != GOut[s].end()) {
+                auto newEdge = it->second;
+                newEdge->AddSubEdge(edges, edge);
                 continue;
             }
 
@@ -303,146 +818,112 @@ namespace MSCSC {
     }
 
     void ReducedGraph::InsertionSCC(IncOutput& output) {
+        Extend();
+
+        tarjan->SetInternal(output.addedEdge, true);
+        MergeEdges(output);
+    }
+
+    void ReducedGraph::InsertionSCC(map<int, IncOutput>& collectOutput) {
+        Extend();
+
+        for (auto& [k, output] : collectOutput) {
+            // output.addedEdge->internal = true;
+            MergeEdges(output);
+        }
+    }
+
+    void ReducedGraph::MergeEdges(IncOutput& output) {
         int finalID = output.finalID;
-        output.addedEdge->internal = true;
-        
-        // manage the external edge; 1. some should be internal 2. others may change relationship
-        set<int> affNodeFor, affNodeBack;
+        auto& edges = tarjan->edges;
 
-        set<SuperEdge*> deleteEdgeSet;
-        vector<set<EdgeNode*>> newEdgeSetList;
-        newEdgeSetList.reserve(output.affNode.size()); // may be more?
+        auto& merged = mergedNode_;
+        merged.Clear();
+        for (auto node : output.affNode) {
+            merged.Insert(node);
+        }
+
+        // manage the external edge; 1. some should be internal 2. others may change relationship
+        auto& deleteEdgeList = deleteEdge_;
+        auto& addEdgeList = addEdge_;
+        deleteEdgeList.clear();
+        addEdgeList.clear();
 
         for (auto node : output.affNode) {
             for (auto& [key, edge] : GOut[node]) {
-                deleteEdgeSet.emplace(edge);
+                deleteEdgeList.emplace_back(edge);
 
                 int t = tarjan->Find(edge->t);
-                if (t == finalID || output.affNode.find(edge->t) != output.affNode.end()) { // t may be an affected but empty node
+                if (t == finalID || merged.Contains(edge->t)) { // t may be an affected but empty node
                     for (auto i : edge->subEdge) {
-                        i->internal = true;
+                        tarjan->SetInternal(i, true);
                     }
                 } else {
-                    newEdgeSetList.emplace_back(move(edge->subEdge)); // may reduce copy
+                    addEdgeList.insert(addEdgeList.end(), edge->subEdge.begin(), edge->subEdge.end());
                 }
             }
 
             for (auto& [key, edge] : GIn[node]) {
-                deleteEdgeSet.emplace(edge);
+                if (merged.Contains(edge->s)) { // taken from GOut of s
+                    continue;
+                }
+
+                deleteEdgeList.emplace_back(edge);
 
                 int s = tarjan->Find(edge->s);
-                if (s == finalID || output.affNode.find(edge->s) != output.affNode.end()) {
+                if (s == finalID) {
                     for (auto i : edge->subEdge) {
-                        i->internal = true;
+                        tarjan->SetInternal(i, true);
                     }
                 } else {
-                    newEdgeSetList.emplace_back(move(edge->subEdge));
+                    addEdgeList.insert(addEdgeList.end(), edge->subEdge.begin(), edge->subEdge.end());
                 }
             }
         }
 
         // batch deletion
-        for (auto edge : deleteEdgeSet) {
+        for (auto edge : deleteEdgeList) {
             DeleteEdge(edge);
         }
 
-        // batch insertion
-        for (auto& addEdgeList : newEdgeSetList) {
-            for (auto edge : addEdgeList) {
-                int s = tarjan->Find(edge->s);
-                int t = tarjan->Find(edge->t);
-
-                if (s == t) {
-                    edge->internal = true;
-                    continue;
-                }
-
-                if (GOut[s].find(t) != GOut[s].end()) {
-                    auto newEdge = GOut[s][t];
-                    newEdge->subEdge.emplace(edge);
-                    continue;
-                }
-
-                AddEdge(edge);
-            }
+        if (orderCycle) { // the edges against the order were inside the merged nodes
+            orderValid = true;
+            orderCycle = false;
         }
-    }
-
-    void ReducedGraph::InsertionSCC(map<int, IncOutput>& collectOutput) {
-        for (auto& [k, output] : collectOutput) {
-            int finalID = output.finalID;
-            // output.addedEdge->internal = true;
-            
-            // manage the external edge; 1. some should be internal 2. others may change relationship
-            set<int> affNodeFor, affNodeBack;
-
-            set<SuperEdge*> deleteEdgeSet;
-            vector<set<EdgeNode*>> newEdgeSetList;
-            newEdgeSetList.reserve(output.affNode.size()); // may be more?
-
-            for (auto node : output.affNode) {
-                for (auto& [key, edge] : GOut[node]) {
-                    deleteEdgeSet.emplace(edge);
 
-                    int t = tarjan->Find(edge->t);
-                    if (t == finalID || output.affNode.find(edge->t) != output.affNode.end()) { // t may be an affected but empty node
-                        for (auto i : edge->subEdge) {
-                            i->internal = true;
-                        }
-                    } else {
-                        newEdgeSetList.emplace_back(move(edge->subEdge)); // may reduce copy
-                    }
-                }
+        for (auto node : output.affNode) { // the merged node reaches whatever its parts reach
+            Include(finalID, node);
+        }
+        PropagateLabel(finalID); // to the in-edges it already has
 
-                for (auto& [key, edge] : GIn[node]) {
-                    deleteEdgeSet.emplace(edge);
+        // batch insertion
+        for (auto edge : addEdgeList) {
+            int s = tarjan->Find(edges.s[edge]);
+            int t = tarjan->Find(edges.t[edge]);
 
-                    int s = tarjan->Find(edge->s);
-                    if (s == finalID || output.affNode.find(edge->s) != output.affNode.end()) {
-                        for (auto i : edge->subEdge) {
-                            i->internal = true;
-                        }
-                    } else {
-                        newEdgeSetList.emplace_back(move(edge->subEdge));
-                    }
-                }
+            if (s == t) {
+                tarjan->SetInternal(edge, true);
+                continue;
             }
 
-            // batch deletion
-            for (auto edge : deleteEdgeSet) {
-                DeleteEdge(edge);
+            auto it = GOut[s].find(t);
+            if (it != GOut[s].end()) {
+                auto newEdge = it->second;
+                newEdge->AddSubEdge(edges, edge);
+                continue;
             }
 
-            // batch insertion
-            for (auto& addEdgeList : newEdgeSetList) {
-                for (auto edge : addEdgeList) {
-                    int s = tarjan->Find(edge->s);
-                    int t = tarjan->Find(edge->t);
-
-                    if (s == t) {
-                        edge->internal = true;
-                        continue;
-                    }
-
-                    if (GOut[s].find(t) != GOut[s].end()) {
-                        auto newEdge = GOut[s][t];
-                        newEdge->subEdge.emplace(edge);
-                        continue;
-                    }
-
-                    AddEdge(edge);
-                }
-            }
+            AddEdge(edge);
         }
     }
 
-    map<int, IncOutput> ReducedGraph::BatchInsertion(vector<EdgeNode*>& edgeList) {
+    map<int, IncOutput> ReducedGraph::BatchInsertion(vector<int>& edgeList) {
         unordered_set<int> sourceNode;
 
         for (auto edge : edgeList) {
             SingleInsertion(edge);
-            sourceNode.emplace(tarjan->Find(edge->s));
-            sourceNode.emplace(tarjan->Find(edge->t));
+            sourceNode.emplace(tarjan->Find(tarjan->edges.s[edge]));
+            sourceNode.emplace(tarjan->Find(tarjan->edges.t[edge]));
         }
 
         Args args(inStack_, dfn_, low_, visited_);
@@ -466,13 +947,16 @@ namespace MSCSC {
         for (auto edge : necEdge) {
             int id = Find(edge->s);
             if (Find(edge->s) == Find(edge->t)) {
-                output[id].affNode.emplace(edge->s);
-                output[id].affNode.emplace(edge->t);
+                output[id].affNode.emplace_back(edge->s);
+                output[id].affNode.emplace_back(edge->t);
                 output[id].necEdge.emplace_back(edge);
             }
         }
 
         for (auto& [k, v] : output) {
+            sort(v.affNode.begin(), v.affNode.end()); // each node once
+            v.affNode.erase(unique(v.affNode.begin(), v.affNode.end()), v.affNode.end());
+
             for (auto id : v.affNode) {
                 sccMap[id] = -1;
             }
@@ -482,49 +966,77 @@ namespace MSCSC {
     }
 
     void ReducedGraph::Build(int u, Args& args, unordered_set<SuperEdge*>& necEdge) {
+        BuildFrom(u, args, &necEdge);
+    }
+
+    void ReducedGraph::BuildFrom(int u, Args& args, unordered_set<SuperEdge*>* necEdge) {
         auto& dfn = args.dfn;
         auto& low = args.low;
         auto& dfnNum = args.dfnNum;
         auto& dfsStack = args.dfsStack;
         auto& inStack = args.inStack;
         auto& visited = args.visited;
+        auto& frame = args.superEdgeFrame;
+
+        auto enter = [&](int x) {
+            visited.emplace_back(x);
+            dfn[x] = low[x] = ++dfnNum;
+            dfsStack.emplace_back(x);
+            inStack[x] = 1;
+            frame.push_back({x, GOut[x].begin(), nullptr, false});
+        };
 
-        visited.emplace_back(u);
-        dfn[u] = low[u] = ++dfnNum;
-        dfsStack.push(u);
-        inStack[u] = 1;
-        SuperEdge* lastDrop = nullptr;
+        enter(u);
 
-        for (auto [key, edge] : GOut[u]) {
-            int v = edge->t;
+        while (!frame.empty()) {
+            auto& now = frame.back();
+            int x = now.u;
 
-            if (!dfn[v]) {
-                necEdge.emplace(edge);
-                Build(v, args, necEdge);
+            if (now.it != GOut[x].end()) {
+                auto edge = now.it->second;
+                int v = edge->t;
 
-                if (low[v] <= low[u]) {
-                    lastDrop = edge;
-                    low[u] = low[v];
+                if (!dfn[v]) {
+                    if (necEdge) {
+                        necEdge->emplace(edge);
+                    }
+                    enter(v);
+                    continue; // now.it moves on when v is done
+                } else if (inStack[v] && low[x] > dfn[v]) {
+                    now.lastDrop = edge;
+                    low[x] = dfn[v];
                 }
-            } else if (inStack[v] && low[u] > dfn[v]) {
-                lastDrop = edge;
-                low[u] = dfn[v];
+
+                ++now.it;
+                continue;
             }
-        }
 
-        if (lastDrop) { // before return, update the last dropping edge
-            necEdge.emplace(lastDrop);
-        }
+            // all edges of x are done
+            if (now.lastDrop && necEdge) { // before return, update the last dropping edge
+                necEdge->emplace(now.lastDrop);
+            }
 
-        if (low[u] == dfn[u]) {
-            while (dfsStack.top() != u) {
-                Merge(u, dfsStack.top());
-                inStack[dfsStack.top()] = 0;
-                dfsStack.pop();
+            if (low[x] == dfn[x]) {
+                while (dfsStack.back() != x) {
+                    Merge(x, dfsStack.back());
+                    inStack[dfsStack.back()] = 0;
+                    dfsStack.pop_back();
+                }
+
+                inStack[x] = 0;
+                dfsStack.pop_back(); // s[tail] = u
             }
 
-            inStack[u] = 0;
-            dfsStack.pop(); // s[tail] = u
+            frame.pop_back();
+
+            if (!frame.empty()) { // back to the parent through the tree edge
+                auto& parent = frame.back();
+                if (low[x] <= low[parent.u]) {
+                    parent.lastDrop = parent.it->second;
+                    low[parent.u] = low[x];
+                }
+                ++parent.it;
+            }
         }
     }
 
@@ -547,33 +1059,36 @@ namespace MSCSC {
         return sccMap[u] < 0 ? u : sccMap[u] = Find(sccMap[u]);
     }
 
-    void ReducedGraph::SingleDeletion(EdgeNode* deleteEdge) {
-        int s = tarjan->Find(deleteEdge->s);
-        int t = tarjan->Find(deleteEdge->t);
+    void ReducedGraph::SingleDeletion(int deleteEdge) {
+        auto& edges = tarjan->edges;
+        int s = tarjan->Find(edges.s[deleteEdge]);
+        int t = tarjan->Find(edges.t[deleteEdge]);
         if (s == t) {
             return;
         }
 
         auto edge = GOut[s][t];
-        edge->subEdge.erase(deleteEdge);
+        edge->RemoveSubEdge(edges, deleteEdge);
 
         if (!edge->subEdge.size()) { 
             DeleteEdge(edge);
         }
     }
 
-    void ReducedGraph::SingleInsertion(EdgeNode* newEdge) {
-        int s = tarjan->Find(newEdge->s);
-        int t = tarjan->Find(newEdge->t);
+    void ReducedGraph::SingleInsertion(int newEdge) {
+        auto& edges = tarjan->edges;
+        int s = tarjan->Find(edges.s[newEdge]);
+        int t = tarjan->Find(edges.t[newEdge]);
 
         if (s == t) {
-            newEdge->internal = true;
+            tarjan->SetInternal(newEdge, true);
             return;
         }
 
-        if (GOut[s].find(t) != GOut[s].end()) {
-            auto edge = GOut[s][t];
-            edge->subEdge.emplace(newEdge);
+        auto it = GOut[s].find(t);
+        if (it != GOut[s].end()) {
+            auto edge = it->second;
+            edge->AddSubEdge(edges, newEdge);
             return;
         }
 
@@ -581,27 +1096,30 @@ namespace MSCSC {
     }
 
 
-    void ReducedGraph::AddEdge(EdgeNode* newEdge) {
-        int s = tarjan->Find(newEdge->s);
-        int t = tarjan->Find(newEdge->t);
+    void ReducedGraph::AddEdge(int newEdge) {
+        auto& edges = tarjan->edges;
+        int s = tarjan->Find(edges.s[newEdge]);
+        int t = tarjan->Find(edges.t[newEdge]);
 
-        auto edge = new SuperEdge(s, t);
-        edge->subEdge.emplace(newEdge);
+        auto edge = superEdgePool.New(s, t);
+        edge->AddSubEdge(edges, newEdge);
         GOut[s][t] = edge;
         GIn[t][s] = edge;
+        UpdateOrder(s, t);
+        WidenLabel(s, t);
     }
 
     void ReducedGraph::DeleteEdge(int s, int t, bool isSame) {
         auto edge = GOut[s][t];
         GOut[s].erase(t);
         GIn[t].erase(s);
-        delete edge;
+        superEdgePool.Delete(edge);
     }
 
     void ReducedGraph::DeleteEdge(SuperEdge* edge){
         GOut[edge->s].erase(edge->t);
         GIn[edge->t].erase(edge->s);
-        delete edge;
+        superEdgePool.Delete(edge);
     }
 
 }
@@ -3,6 +3,9 @@
 #include "timer.h"
 #include "config.h"
 #include "tarjan.h"
+#include "pool.h"
+#include "AdjacencyMap.h"
+#include "SparseSet.h"
 
 #include <string>
 #include <vector>
@@ -19,24 +22,31 @@ namespace MSCSC {
     public:
         ReducedGraph() = default;
         ReducedGraph(Tarjan* tarjan);
+        ~ReducedGraph();
 
-        // check if it needs merge
-        bool MayMergeDFS(int s, int t, int now, IncOutput& output, vector<int>& visited);
-        IncOutput MayMerge(int s, int t);
+        // check if it needs merge, output.affNode stays empty if not
+        void MayMerge(int s, int t, IncOutput& output);
+
+        // reachability between two scc nodes: topological order, interval labels, then a bounded bidirectional search
+        bool Reachable(int s, int t);
+
+        // label(t) inside label(s) for every super edge (s, t), for the consistency check of the driver
+        bool CheckLabel();
 
         // minimum insertion implementation
-        IncOutput InsertionMinimum(EdgeNode* newEdge);
+        void InsertionMinimum(int newEdge, IncOutput& output);
         void OnlyTarjan(int u, Args& args);
 
         // delete with scc spilt
         void DeletionSCC(DecOutput& output);
+        void DeletionSCC(vector<DecOutput>& outputList, int num); // the first num outputs of a batch, split in disjoint sccs by tarjan before any of them is applied
 
         // insert with scc merge
         void InsertionSCC(IncOutput& output);
 
         // batch insertion
         void InsertionSCC(map<int, IncOutput>& collectOutput);
-        map<int, IncOutput> BatchInsertion(vector<EdgeNode*>& edgeList);
+        map<int, IncOutput> BatchInsertion(vector<int>& edgeList);
         void Build(int u, Args& args, unordered_set<SuperEdge*>& necEdge);
 
         // helper
@@ -45,36 +55,105 @@ namespace MSCSC {
 
         // general case
         // single deletion
-        void SingleDeletion(EdgeNode* deleteEdge);
+        void SingleDeletion(int deleteEdge);
 
         // single insertion
-        void SingleInsertion(EdgeNode* newEdge);
+        void SingleInsertion(int newEdge);
 
         // manage edge
-        void AddEdge(EdgeNode* newEdge);
+        void AddEdge(int newEdge);
         void DeleteEdge(int s, int t, bool isSame);
         void DeleteEdge(SuperEdge* edge);
 
+        // checkpoint
+        void Serialize(FILE* file);
+        void Deserialize(FILE* file, Tarjan* tarjan_);
+
+        // follow tarjan after it grew its vertex slots or its scc id space
+        void Extend();
+
+    private:
+        void ResizeScratch();
+        void Remap(); // the scc ids moved up with the new vertex slots
+
+        void MergeEdges(IncOutput& output); // super edges of the merged nodes, after tarjan merged them
+        void InheritLabel(DecOutput& output); // the parts of a split scc start from its label
+        void SplitEdges(DecOutput& output); // super edges of the split scc, after the labels of every split in flight
+
+        void BuildFrom(int u, Args& args, unordered_set<SuperEdge*>* necEdge); // iterative tarjan, collect nec edges if necEdge is given
+
+        // topological order
+        void BuildOrder(); // from scratch, orderValid stays false if the graph has a cycle
+        void UpdateOrder(int s, int t); // after adding the super edge (s, t), Pearce-Kelly reorder
+
+        // interval labels, label(t) inside label(s) whenever t is reachable from s
+        void BuildLabel(); // from scratch, the graph must be a DAG
+        bool LabelContains(int u, int v);
+        void WidenLabel(int s, int t); // after adding the super edge (s, t)
+        void Include(int u, int v); // widen label(u) to cover label(v)
+        void PropagateLabel(int u); // widen the ancestors of u to cover label(u)
+
+        // bidirectional search from `from` over GOut and from `to` over GIn, pruned by the order and the labels
+        bool Meet(int from, int to); // true once the two sides meet, the marks stay in state until ClearSearch
+        bool Expand(vector<int>& frontier, bool forward); // one level, true if it touches the other side
+        void Mark(int x, int flag, SuperEdge* edge);
+        void ClearSearch();
+
     public:
         Tarjan* tarjan;
 
         int originalN;
         int extendN;
-        int n; // n = originalN + 1 + extendN;
+        int n; // n = originalN + 1 + extendN; extendN follows tarjan->extendN
 
-        vector<map<int, SuperEdge*>> GOut; // after sscMap,    key: nodeID
-        vector<map<int, SuperEdge*>> GIn;
+        vector<AdjacencyMap> GOut; // after sscMap,    key: nodeID
+        vector<AdjacencyMap> GIn;
 
-        // vector<vector<EdgeNode*>> sccNodeMap; // TODO
+        Pool::ObjectPool<SuperEdge> superEdgePool; // every SuperEdge in GOut/GIn comes from here
+
+        // vector<vector<int>> sccNodeMap; // TODO
 
         Timer::Timer myTimer;
 
         vector<int> state;
 
+        // dynamic topological order of the reduced graph
+        vector<int> ord; // ord[s] < ord[t] for every super edge (s, t) when orderValid; a permutation of [0, n]
+        bool orderValid = false; // false after an edge closed a cycle, rebuilt by the next MayMerge
+        bool orderCycle = false; // the order only breaks on the edges inside the cycle of the last edge, valid again once they are merged
+        enum { ORDER_FORWARD = 1, ORDER_BACKWARD = 2 }; // bits of orderMark
+        vector<char> orderMark;
+        vector<int> orderForward;
+        vector<int> orderBackward;
+        vector<int> orderStack;
+        vector<int> orderNode;
+
+
+        // interval labels of REACH_LABEL_NUM traversals, node x uses [x*REACH_LABEL_NUM, (x+1)*REACH_LABEL_NUM)
+        vector<pair<int, int>> reachLabel;
+        long long widenNum = 0; // labels widened since BuildLabel
+
+        // bidirectional search of MayMerge and Reachable
+        enum { SEARCH_FORWARD = 1, SEARCH_BACKWARD = 2, SEARCH_PATH = 4 }; // bits of state
+        vector<SuperEdge*> forwardParent; // edge that first reached the node from the source
+        vector<SuperEdge*> backwardParent; // edge that first reached the target from the node
+        int searchFrom_;
+        int searchTo_;
+        vector<int> searchVisited_;
+        vector<int> searchForward_;
+        vector<int> searchBackward_;
+        vector<int> searchNext_;
+
         vector<int> sccMap;
         vector<int> inStack_;
         vector<int> dfn_;
         vector<int> low_;
         vector<int> visited_;
+
+        // scratch of the updates, kept so an update allocates none of them
+        Args args_{inStack_, dfn_, low_, visited_};
+        SparseSet mergedNode_;
+        vector<SuperEdge*> deleteEdge_;
+        vector<int> addEdge_;
     };
 }
\ No newline at end of file
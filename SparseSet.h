@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace MSCSC {
+
+    // set of non-negative ids with O(1) insert, erase, lookup and clear, for scratch sets that are cleared and filled again
+    // nothing is allocated once it has seen its largest id; ids stay in insertion order until an erase moves the last one
+    class SparseSet {
+    public:
+        void Insert(int x) {
+            if (Contains(x)) {
+                return;
+            }
+
+            if ((size_t) x >= position.size()) {
+                position.resize(x + 1);
+            }
+            position[x] = dense.size();
+            dense.emplace_back(x);
+        }
+
+        void Erase(int x) { // swap with the last one
+            if (!Contains(x)) {
+                return;
+            }
+
+            int last = dense.back();
+            dense[position[x]] = last;
+            position[last] = position[x];
+            dense.pop_back();
+        }
+
+        bool Contains(int x) const {
+            return (size_t) x < position.size() && (size_t) position[x] < dense.size() && dense[position[x]] == x;
+        }
+
+        void Clear() {
+            dense.clear(); // stale positions are told apart by dense
+        }
+
+        size_t size() const { return dense.size(); }
+        bool empty() const { return dense.empty(); }
+        std::vector<int>::const_iterator begin() const { return dense.begin(); }
+        std::vector<int>::const_iterator end() const { return dense.end(); }
+
+    private:
+        std::vector<int> dense;
+        std::vector<int> position; // position[x] in dense
+    };
+
+}
@@ -0,0 +1,242 @@
+#include "UpdateReader.h"
+#include "binaryio.h"
+
+#include <cstring>
+#include <cctype>
+#include <climits>
+
+namespace MSCSC {
+    UpdateReader::UpdateReader(string filePath) {
+        fileInput = fopen(filePath.c_str(), "rb");
+        if (!fileInput) {
+            printf("can not open file\n");
+            exit(30);
+        }
+
+        char magic[8] = {0};
+        isBinary = fread(magic, 1, 8, fileInput) == 8 && memcmp(magic, UPDATE_MAGIC, 8) == 0;
+        if (isBinary) {
+            int version;
+            BinaryIO::ReadValue(fileInput, version);
+            if (version != UPDATE_VERSION) {
+                printf("unsupported update log version\n");
+                exit(30);
+            }
+        } else {
+            rewind(fileInput);
+        }
+
+        blockPool.resize(UPDATE_QUEUE_BLOCK_NUM);
+        for (auto& block : blockPool) {
+            block.reserve(UPDATE_BLOCK_SIZE);
+            freeQueue.push(&block);
+        }
+
+        reader = thread(&UpdateReader::Run, this);
+    }
+
+    UpdateReader::~UpdateReader() {
+        // wake the reader thread if it waits for a free block, it stops instead of reading the rest of the log
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stop = true;
+        }
+        freeCond.notify_all();
+
+        reader.join();
+        fclose(fileInput);
+    }
+
+    bool UpdateReader::Next(UpdateOp& update) {
+        while (!nowBlock || nowPos == nowBlock->size()) {
+            unique_lock<mutex> lock(queueMutex);
+
+            if (nowBlock) { // give the consumed block back to the reader
+                freeQueue.push(nowBlock);
+                nowBlock = nullptr;
+                freeCond.notify_one();
+            }
+
+            fullCond.wait(lock, [&]() { return !fullQueue.empty() || finish; });
+            if (fullQueue.empty()) {
+                return false;
+            }
+
+            nowBlock = fullQueue.front();
+            fullQueue.pop();
+            nowPos = 0;
+        }
+
+        update = (*nowBlock)[nowPos++];
+        return true;
+    }
+
+    vector<UpdateOp>* UpdateReader::AcquireFreeBlock() {
+        unique_lock<mutex> lock(queueMutex);
+        freeCond.wait(lock, [&]() { return !freeQueue.empty() || stop; });
+        if (stop) {
+            return nullptr;
+        }
+
+        auto block = freeQueue.front();
+        freeQueue.pop();
+        block->clear();
+
+        return block;
+    }
+
+    void UpdateReader::PushFullBlock(vector<UpdateOp>* block) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (block->empty()) {
+                freeQueue.push(block);
+                return;
+            }
+            fullQueue.push(block);
+        }
+        fullCond.notify_one();
+    }
+
+    void UpdateReader::Run() {
+        if (isBinary) {
+            ReadBinary();
+        } else {
+            ReadText();
+        }
+
+        {
+            lock_guard<mutex> lock(queueMutex);
+            finish = true;
+        }
+        fullCond.notify_all();
+    }
+
+    void UpdateReader::ReadBinary() {
+        while (true) {
+            auto block = AcquireFreeBlock();
+            if (!block) {
+                return;
+            }
+            block->resize(UPDATE_BLOCK_SIZE);
+            size_t num = fread(block->data(), sizeof(UpdateOp), UPDATE_BLOCK_SIZE, fileInput);
+            block->resize(num);
+            for (auto& update : *block) { // same records the text log can produce
+                BinaryIO::Check((update.type == UPDATE_INSERTION || update.type == UPDATE_DELETION) && update.u >= 0 && update.v >= 0, "invalid update in binary update log");
+            }
+            PushFullBlock(block);
+
+            if (num < UPDATE_BLOCK_SIZE) {
+                return;
+            }
+        }
+    }
+
+    void UpdateReader::ReadText() {
+        const size_t bufferSize = 1 << 20;
+        vector<char> buffer(bufferSize);
+        size_t remain = 0; // bytes of an unfinished line kept at the front of the buffer
+
+        auto block = AcquireFreeBlock();
+        if (!block) {
+            return;
+        }
+
+        while (true) {
+            size_t num = fread(buffer.data() + remain, 1, bufferSize - remain, fileInput);
+            size_t size = remain + num;
+            bool eof = num == 0;
+
+            size_t lineBegin = 0;
+            for (size_t i=0;i<size;i++) {
+                if (buffer[i] != '\n' && !(eof && i == size - 1)) {
+                    continue;
+                }
+
+                // one line: <op> <u> <v>, op is + (insertion) or - (deletion)
+                const char* p = buffer.data() + lineBegin;
+                const char* end = buffer.data() + i + 1;
+                lineBegin = i + 1;
+
+                while (p < end && isspace(*p)) {
+                    p++;
+                }
+                if (p == end) { // empty line
+                    continue;
+                }
+
+                const char* line = p;
+                UpdateOp update;
+                if (*p == '+') {
+                    update.type = UPDATE_INSERTION;
+                } else if (*p == '-') {
+                    update.type = UPDATE_DELETION;
+                } else {
+                    printf("invalid update: %.*s\n", (int) (end - p), p);
+                    exit(32);
+                }
+                p++;
+
+                // both numbers must be there, a missing one is not vertex 0
+                int value[2] = {0, 0};
+                for (auto& x : value) {
+                    while (p < end && isspace(*p)) {
+                        p++;
+                    }
+                    const char* digit = p;
+                    while (p < end && *p >= '0' && *p <= '9' && x <= (INT_MAX - 9) / 10) {
+                        x = x * 10 + (*p - '0');
+                        p++;
+                    }
+                    if (p == digit || (p < end && !isspace(*p))) {
+                        printf("invalid update: %.*s\n", (int) (end - line), line);
+                        exit(32);
+                    }
+                }
+                update.u = value[0];
+                update.v = value[1];
+
+                block->emplace_back(update);
+                if (block->size() == UPDATE_BLOCK_SIZE) {
+                    PushFullBlock(block);
+                    block = AcquireFreeBlock();
+                    if (!block) {
+                        return;
+                    }
+                }
+            }
+
+            if (eof) {
+                break;
+            }
+
+            // keep the unfinished line
+            remain = size - lineBegin;
+            if (remain == bufferSize) {
+                printf("update line is too long\n");
+                exit(32);
+            }
+            memmove(buffer.data(), buffer.data() + lineBegin, remain);
+        }
+
+        PushFullBlock(block);
+    }
+
+    void UpdateReader::WriteBinary(string textFilePath, string binaryFilePath) {
+        FILE *fileOutput = fopen(binaryFilePath.c_str(), "wb");
+        if (!fileOutput) {
+            printf("can not open file\n");
+            exit(30);
+        }
+
+        BinaryIO::CheckWrite(fwrite(UPDATE_MAGIC, 1, 8, fileOutput) == 8);
+        BinaryIO::WriteValue(fileOutput, UPDATE_VERSION);
+
+        UpdateReader reader(textFilePath);
+        UpdateOp update;
+        while (reader.Next(update)) {
+            BinaryIO::WriteValue(fileOutput, update);
+        }
+
+        BinaryIO::CheckWrite(fclose(fileOutput) == 0); // buffered records are only written out here
+    }
+}
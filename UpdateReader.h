@@ -0,0 +1,58 @@
+#pragma once
+
+#include "config.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace MSCSC {
+    using namespace std;
+
+    // stream a mixed insert/delete update log (text or binary), parsed ahead by a reader thread
+    // memory is bounded by UPDATE_QUEUE_BLOCK_NUM blocks of UPDATE_BLOCK_SIZE updates
+    class UpdateReader {
+    public:
+        UpdateReader(string filePath);
+        ~UpdateReader();
+
+        // return false when the log is exhausted
+        bool Next(UpdateOp& update);
+
+        // convert a text update log into the binary one
+        static void WriteBinary(string textFilePath, string binaryFilePath);
+
+    private:
+        void Run(); // reader thread
+        void ReadText();
+        void ReadBinary();
+
+        // producer side, nullptr once the consumer has stopped
+        vector<UpdateOp>* AcquireFreeBlock();
+        void PushFullBlock(vector<UpdateOp>* block);
+
+    private:
+        FILE* fileInput;
+        bool isBinary;
+
+        vector<vector<UpdateOp>> blockPool;
+        queue<vector<UpdateOp>*> freeQueue;
+        queue<vector<UpdateOp>*> fullQueue;
+        bool finish = false;
+        bool stop = false; // the consumer is gone, the reader thread quits at its next block
+
+        mutex queueMutex;
+        condition_variable freeCond;
+        condition_variable fullCond;
+
+        // consumer side
+        vector<UpdateOp>* nowBlock = nullptr;
+        size_t nowPos = 0;
+
+        thread reader;
+    };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+namespace BinaryIO {
+
+    inline void Check(bool ok, const char* message = "corrupted binary file") {
+        if (!ok) {
+            printf("%s\n", message);
+            exit(31);
+        }
+    }
+
+    // a short write (e.g. a full disk) stops here instead of leaving a truncated file behind
+    inline void CheckWrite(bool ok) {
+        Check(ok, "can not write binary file");
+    }
+
+    template <typename T>
+    void WriteValue(FILE* file, const T& value) {
+        CheckWrite(fwrite(&value, sizeof(T), 1, file) == 1);
+    }
+
+    template <typename T>
+    void ReadValue(FILE* file, T& value) {
+        Check(fread(&value, sizeof(T), 1, file) == 1);
+    }
+
+    // size first, then the elements
+    template <typename T>
+    void WriteVector(FILE* file, const std::vector<T>& list) {
+        WriteValue(file, (unsigned long long) list.size());
+        if (!list.empty()) { // data() may be null
+            CheckWrite(fwrite(list.data(), sizeof(T), list.size(), file) == list.size());
+        }
+    }
+
+    // grows chunk by chunk, so a corrupted size fails at the end of the file instead of allocating it up front
+    template <typename T>
+    void ReadVector(FILE* file, std::vector<T>& list) {
+        const unsigned long long chunkSize = (1 << 20) / sizeof(T) + 1;
+
+        unsigned long long size;
+        ReadValue(file, size);
+        list.clear();
+        for (unsigned long long done=0;done<size;) {
+            auto num = std::min(chunkSize, size - done);
+            list.resize(done + num);
+            Check(fread(list.data() + done, sizeof(T), num, file) == num);
+            done += num;
+        }
+    }
+
+}
@@ -1,25 +1,104 @@
 #pragma once
 
 #include <climits>
-#include <set>
 #include <vector>
 
 #define INF INT_MAX
 
 #define THREAD_NUM 8
-#define INTERNAL_EDGE_THRESHOLD 1000
+#define PARALLEL_CONSTRUCTION 0 // build the initial sccs with ParallelConstruction, the sccs are the same but the needed edges may differ
+#define PARALLEL_FRONTIER_THRESHOLD 4096 // smaller bfs frontiers are expanded by one thread
+#define INTERNAL_EDGE_THRESHOLD 1000 // a split scc with fewer internal edges goes to tarjan right away
+#define SPLIT_RATE_WEIGHT 0.05 // weight of one deleted needed edge in the split rate
+#define SPLIT_FULL_RATE 0.5 // a deletion goes to tarjan right away once it splits with at least this probability
+#define SPLIT_TRIM_THRESHOLD 4096 // a split scc with at least this many nodes left is trimmed with THREAD_NUM threads before tarjan
+#define EDGE_INDEX_THRESHOLD 64 // out-degree above which EdgeRemove uses a hash index instead of a scan
+
+#define ADJ_INIT_SIZE 2 // first allocation of a reduced graph adjacency
+#define ADJ_SMALL_SIZE 16 // power of two, reduced graph adjacency above this size becomes a hash table
+
+#define REACH_LABEL_NUM 2 // interval labels per reduced graph node for reachability queries
+#define QUERY_BOTTOM_UP_ALPHA 14 // QueryBFS goes bottom-up once the frontier has more than m / alpha edges
+#define QUERY_TOP_DOWN_BETA 24 // and back to top-down below (n + 1) / beta frontier nodes
+
+#define CSR_MAGIC "MSCSCCSR"
+#define CSR_VERSION 1
+
+#define CHECKPOINT_MAGIC "MSCSCIDX"
+#define CHECKPOINT_VERSION 3
+
+#define UPDATE_MAGIC "MSCSCUPD"
+#define UPDATE_VERSION 1
+#define UPDATE_BLOCK_SIZE 4096
+#define UPDATE_QUEUE_BLOCK_NUM 16
 
 using namespace std;
 
-struct EdgeNode {
-    bool needed; // may be necessary in the minimum SCC
-    bool internal; // is s & t in the same scc
-    int s;
-    int t;
+// header of the binary graph file, followed by offset[n+2] (unsigned long long) and target[m] (int)
+struct CSRHeader {
+    char magic[8];
+    unsigned int version;
+    int n;
+    unsigned long long m;
+};
+
+// flags of an edge, packed into one byte
+enum EdgeFlag : unsigned char {
+    EDGE_NEEDED = 1, // may be necessary in the minimum SCC
+    EDGE_INTERNAL = 2, // is s & t in the same scc
+};
+
+// every edge of the graph as parallel arrays, an edge is its index; removed indices are reused
+// the flags take a byte and not a bit per edge, so threads setting flags of different edges never share a word
+struct EdgeStore {
+    vector<int> s;
+    vector<int> t;
+    vector<int> subIndex; // position in SuperEdge::subEdge, valid only for external edges
+    vector<int> inIndex; // position in Tarjan::GIn[t]
+    vector<unsigned char> flag;
+    vector<int> freeEdge; // removed indices, used as a stack
 
-    EdgeNode() = default;
+    int New(int u, int v) {
+        int edge;
+        if (freeEdge.empty()) {
+            edge = Append(1);
+        } else {
+            edge = freeEdge.back();
+            freeEdge.pop_back();
+        }
 
-    EdgeNode(int s, int t) : s(s), t(t), needed(false), internal(false) {}
+        Set(edge, u, v);
+        return edge;
+    }
+
+    void Delete(int edge) {
+        flag[edge] = 0;
+        freeEdge.emplace_back(edge);
+    }
+
+    // num new indices in a row, returns the first one; they are filled by Set, several threads may fill their own range
+    int Append(size_t num) {
+        int first = s.size();
+        s.resize(first + num);
+        t.resize(first + num);
+        subIndex.resize(first + num);
+        inIndex.resize(first + num);
+        flag.resize(first + num);
+        return first;
+    }
+
+    void Set(int edge, int u, int v) {
+        s[edge] = u;
+        t[edge] = v;
+        subIndex[edge] = -1;
+        flag[edge] = 0;
+    }
+
+    bool Needed(int edge) const { return flag[edge] & EDGE_NEEDED; }
+    bool Internal(int edge) const { return flag[edge] & EDGE_INTERNAL; }
+
+    void SetNeeded(int edge, bool value) { flag[edge] = value ? flag[edge] | EDGE_NEEDED : flag[edge] & ~EDGE_NEEDED; }
+    void SetInternal(int edge, bool value) { flag[edge] = value ? flag[edge] | EDGE_INTERNAL : flag[edge] & ~EDGE_INTERNAL; }
 };
 
 struct SuperEdge {
@@ -27,24 +106,49 @@ struct SuperEdge {
     int s;
     int t;
     // set<pair<int, int>> subEdge;
-    set<EdgeNode*> subEdge;
+    vector<int> subEdge; // unordered, each sub edge knows its own position
 
     SuperEdge() = default;
 
     SuperEdge(int s, int t) : s(s), t(t) {}
+
+    void AddSubEdge(EdgeStore& edges, int edge) {
+        edges.subIndex[edge] = subEdge.size();
+        subEdge.emplace_back(edge);
+    }
+
+    void RemoveSubEdge(EdgeStore& edges, int edge) { // swap with the last one
+        auto last = subEdge.back();
+        subEdge[edges.subIndex[edge]] = last;
+        edges.subIndex[last] = edges.subIndex[edge];
+        subEdge.pop_back();
+    }
+};
+
+// one record of the update log
+struct UpdateOp {
+    int type; // UPDATE_INSERTION or UPDATE_DELETION
+    int u;
+    int v;
+};
+
+enum UpdateType {
+    UPDATE_INSERTION = 0,
+    UPDATE_DELETION = 1,
 };
 
+// the outputs of an update are filled in place, so their buffers are reused by the next one
 struct IncOutput {
     int finalID; // final scc ID
-    set<int> affNode; // 2hop->tarjan: merged node     tarjan->2hop: delete node
+    vector<int> affNode; // 2hop->tarjan: merged node     tarjan->2hop: delete node; each one once, in no order
     vector<SuperEdge*> necEdge; // 2-hop edges in the DFS path (should be marked as nec edge)
-    EdgeNode* addedEdge;
+    int addedEdge;
 };
 
 struct DecOutput {
     int sccID;
-    set<int> newNode;
-    EdgeNode* deletedEdge;
+    vector<int> newNode; // each one once, in no order
+    int deletedEdge;
     vector<int> sccNodeList;
 };
 
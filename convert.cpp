@@ -0,0 +1,30 @@
+#include "tarjan.h"
+#include "UpdateReader.h"
+
+#include <cstdio>
+
+// convert a text graph file (or update log) into the binary format
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("usage: %s <graph file> <binary graph file>\n", argv[0]);
+        printf("       %s --update <update log> <binary update log>\n", argv[0]);
+        return 1;
+    }
+
+    if (string(argv[1]) == "--update") {
+        if (argc < 4) {
+            printf("usage: %s --update <update log> <binary update log>\n", argv[0]);
+            return 1;
+        }
+
+        MSCSC::UpdateReader::WriteBinary(argv[2], argv[3]);
+        return 0;
+    }
+
+    MSCSC::Tarjan tarjan(argv[1]);
+    tarjan.SaveBinary(argv[2]);
+
+    printf("n: %d m: %llu\n", tarjan.n, tarjan.m);
+
+    return 0;
+}
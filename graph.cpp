@@ -1,7 +1,9 @@
 #include "graph.h"
+#include "binaryio.h"
 
 #include <algorithm>
 #include <queue>
+#include <cstring>
 
 namespace MSCSC {
     Graph::Graph(string filePath) {
@@ -9,13 +11,22 @@ namespace MSCSC {
         tarjan = new Tarjan(filePath);
     }
 
+    Graph::~Graph() {
+        delete reducedGraph; // holds super edges pointing to edges of tarjan
+        delete tarjan;
+    }
+
     void Graph::Construction() {
         ConstructionTarjan();
         ConstructionReducedGraph();
     }
 
     void Graph::ConstructionTarjan() {
-        tarjan->Construction();
+        if (PARALLEL_CONSTRUCTION && THREAD_NUM > 1) {
+            tarjan->ParallelConstruction();
+        } else {
+            tarjan->Construction();
+        }
     }
 
     void Graph::ConstructionReducedGraph() {
@@ -29,7 +40,8 @@ namespace MSCSC {
 
         // merge: 1. not in same scc 2. no such edge in the reduced graph
         if (!tarjan->InSameSCC(u, v) && reducedGraph->GOut[tarjan->Find(u)].find(tarjan->Find(v)) == reducedGraph->GOut[tarjan->Find(u)].end()) { // scc may merge
-            auto output = reducedGraph->MayMerge(tarjan->Find(u), tarjan->Find(v)); // check in the reduced graph
+            auto& output = incOutput_;
+            reducedGraph->MayMerge(tarjan->Find(u), tarjan->Find(v), output); // check in the reduced graph
 
             if (output.affNode.empty()) { // no merge
                 reducedGraph->SingleInsertion(edge);
@@ -48,9 +60,11 @@ namespace MSCSC {
         auto edge = tarjan->EdgeInsertion(u, v);
 
         if (!tarjan->InSameSCC(u, v) && reducedGraph->GOut[tarjan->Find(u)].find(tarjan->Find(v)) == reducedGraph->GOut[tarjan->Find(u)].end()) {
-            auto output = reducedGraph->InsertionMinimum(edge); // ref?
+            auto& output = incOutput_;
+            reducedGraph->InsertionMinimum(edge, output);
             if (!output.affNode.empty()) {
                 sccMergeNum++;
+                output.addedEdge = edge;
                 tarjan->InsertionSCC(output);
                 reducedGraph->InsertionSCC(output);
             }
@@ -62,22 +76,24 @@ namespace MSCSC {
     void Graph::Deletion(int u, int v) {
         auto edge = tarjan->EdgeRemove(u, v);
 
-        if (tarjan->InSameSCC(u, v) && edge->needed) { // scc may split
+        if (tarjan->InSameSCC(u, v) && tarjan->edges.Needed(edge)) { // scc may split
             sccTrySplitNum++;
-            auto output = tarjan->DeletionSCC(u, v);
+            auto& output = decOutput_;
+            tarjan->DeletionSCC(u, v, output);
 
             if (output.newNode.size() > 1) { // split
                 sccRealSplitNum++;
                 output.deletedEdge = edge;
                 reducedGraph->DeletionSCC(output);
             } else {
+                reducedGraph->Extend(); // tarjan may have grown the scc id space even though the scc stayed whole
                 reducedGraph->SingleDeletion(edge);
             }
         } else { // just delelte
             reducedGraph->SingleDeletion(edge);
         }
 
-        delete edge;
+        tarjan->EdgeRelease(edge);
     }
 
     void Graph::DeletionWithoutPruningPower(int u, int v) {
@@ -85,20 +101,22 @@ namespace MSCSC {
 
         if (tarjan->InSameSCC(u, v)) { // scc may split
             sccTrySplitNumNoPrune++;
-            auto output = tarjan->DeletionSCC(u, v);
+            auto& output = decOutput_;
+            tarjan->DeletionSCC(u, v, output);
 
             if (output.newNode.size() > 1) { // split
                 sccRealSplitNumNoPrune++;
                 output.deletedEdge = edge;
                 reducedGraph->DeletionSCC(output);
             } else {
+                reducedGraph->Extend(); // tarjan may have grown the scc id space even though the scc stayed whole
                 reducedGraph->SingleDeletion(edge);
             }
         } else { // just delelte
             reducedGraph->SingleDeletion(edge);
         }
 
-        delete edge;
+        tarjan->EdgeRelease(edge);
     }
 
     void Graph::BatchDeletion(vector<pair<int, int>>& edgeList) {
@@ -110,42 +128,57 @@ namespace MSCSC {
             } else { // external edge
                 auto edge = tarjan->EdgeRemove(u, v);
                 reducedGraph->SingleDeletion(edge);
-                delete edge;
+                tarjan->EdgeRelease(edge);
             }
         }
 
+        vector<SplitTask> taskList;
+
         for (auto& [sccID, deletedEdgeList] : deletedSCCEdgeList) {
             vector<pair<int, int>> tmpEdgeList;
             for (auto [u, v] : deletedEdgeList) {
                 auto edge = tarjan->EdgeRemove(u, v);
-                if (edge->needed) {
+                if (tarjan->edges.Needed(edge)) {
                     tmpEdgeList.emplace_back(u, v);
                 } 
-                delete edge;
+                tarjan->EdgeRelease(edge);
             }
             
-            if (tmpEdgeList.size() == 1) {
-                sccTrySplitNum++;
-                auto output = tarjan->DeletionSCC(tmpEdgeList.front().first, tmpEdgeList.front().second);
-
-                if (output.newNode.size() > 1) { // split
-                    reducedGraph->DeletionSCC(output);
-                    sccRealSplitNum++;
-                }
-            } else if (tmpEdgeList.size() > 1) {
-                sccTrySplitNum++;
-                auto output = tarjan->BatchDeletionSCC(sccID);
-
-                if (output.newNode.size() > 1) {
-                    reducedGraph->DeletionSCC(output);
-                    sccRealSplitNum++;
-                }
+            if (!tmpEdgeList.empty()) {
+                taskList.push_back({sccID, move(tmpEdgeList)});
+            }
+        }
+
+        sccTrySplitNum += taskList.size();
+
+        // the sccs share no nodes, so they are split at the same time; the reduced graph then takes all outputs at once,
+        // since an edge of one split may point into a part of another
+        auto& outputList = decOutputList_; // only the first taskList.size() are filled
+        if (taskList.size() > 1) {
+            tarjan->ParallelDeletionSCC(taskList, outputList);
+        } else if (taskList.size() == 1) {
+            auto& task = taskList.front();
+            if (outputList.empty()) {
+                outputList.resize(1);
+            }
+
+            if (task.edgeList.size() == 1) {
+                tarjan->DeletionSCC(task.edgeList.front().first, task.edgeList.front().second, outputList.front());
+            } else {
+                tarjan->BatchDeletionSCC(task.sccID, task.edgeList, outputList.front());
+            }
+        }
+
+        for (int i=0;i<(int) taskList.size();i++) {
+            if (outputList[i].newNode.size() > 1) { // split
+                sccRealSplitNum++;
             }
         }
+        reducedGraph->DeletionSCC(outputList, taskList.size());
     }
 
     void Graph::BatchInsertion(vector<pair<int, int>>& edgeList) {
-        vector<EdgeNode*> newEdgeList;
+        vector<int> newEdgeList;
         newEdgeList.reserve(edgeList.size());
 
         for (auto [u, v] : edgeList) {
@@ -158,6 +191,39 @@ namespace MSCSC {
         sccMergeNum += output.size();
     }
 
+    int Graph::AddVertex() {
+        int u = tarjan->AddVertex();
+        reducedGraph->Extend();
+        return u;
+    }
+
+    void Graph::RemoveVertex(int u) {
+        auto& edges = tarjan->edges;
+        vector<pair<int, int>> edgeList;
+        for (auto edge : tarjan->G[u]) {
+            edgeList.emplace_back(u, edges.t[edge]);
+        }
+        for (auto edge : tarjan->GIn[u]) {
+            if (edges.s[edge] != u) { // a self loop is an out-edge already
+                edgeList.emplace_back(edges.s[edge], u);
+            }
+        }
+
+        BatchDeletion(edgeList);
+        tarjan->RemoveVertex(u);
+    }
+
+    bool Graph::Reachable(int u, int v) {
+        int s = tarjan->Find(u);
+        int t = tarjan->Find(v);
+
+        if (s == t) { // same scc
+            return true;
+        }
+
+        return reducedGraph->Reachable(s, t);
+    }
+
     void Graph::Init() {
         sccRealSplitNum = 0;
         sccTrySplitNum = 0;
@@ -173,4 +239,61 @@ namespace MSCSC {
         printf("\nsccTrySplitNumNoPrune: %d", sccTrySplitNumNoPrune);
         printf("\nsccMergeNum: %d\n\n", sccMergeNum);
     }
+
+    void Graph::Save(string filePath) {
+        FILE *fileOutput = fopen(filePath.c_str(), "wb");
+        if (!fileOutput) {
+            printf("can not open file\n");
+            exit(30);
+        }
+
+        BinaryIO::CheckWrite(fwrite(CHECKPOINT_MAGIC, 1, 8, fileOutput) == 8);
+        BinaryIO::WriteValue(fileOutput, CHECKPOINT_VERSION);
+
+        tarjan->Serialize(fileOutput);
+        reducedGraph->Serialize(fileOutput);
+
+        int counter[5] = {sccRealSplitNum, sccTrySplitNum, sccRealSplitNumNoPrune, sccTrySplitNumNoPrune, sccMergeNum};
+        BinaryIO::WriteValue(fileOutput, counter);
+
+        BinaryIO::CheckWrite(fclose(fileOutput) == 0); // buffered data is only written here
+    }
+
+    void Graph::Load(string filePath) {
+        FILE *fileInput = fopen(filePath.c_str(), "rb");
+        if (!fileInput) {
+            printf("can not open file\n");
+            exit(30);
+        }
+
+        myTimer.StartTimer("load checkpoint");
+
+        char magic[8];
+        int version;
+        BinaryIO::ReadValue(fileInput, magic);
+        BinaryIO::ReadValue(fileInput, version);
+        BinaryIO::Check(memcmp(magic, CHECKPOINT_MAGIC, 8) == 0 && version == CHECKPOINT_VERSION);
+
+        delete reducedGraph; // a graph may be loaded over an existing one
+        delete tarjan;
+        reducedGraph = nullptr;
+
+        tarjan = new Tarjan();
+        tarjan->Deserialize(fileInput);
+
+        reducedGraph = new ReducedGraph();
+        reducedGraph->Deserialize(fileInput, tarjan);
+
+        int counter[5];
+        BinaryIO::ReadValue(fileInput, counter);
+        sccRealSplitNum = counter[0];
+        sccTrySplitNum = counter[1];
+        sccRealSplitNumNoPrune = counter[2];
+        sccTrySplitNumNoPrune = counter[3];
+        sccMergeNum = counter[4];
+
+        fclose(fileInput);
+
+        myTimer.EndTimerAndPrint("load checkpoint");
+    }
 }
\ No newline at end of file
@@ -16,7 +16,11 @@ namespace MSCSC {
     class Graph {
     public:
         Graph() = default;
-        Graph(string filePath);
+        Graph(string filePath); // text or binary CSR graph file
+        ~Graph();
+
+        Graph(const Graph&) = delete;
+        Graph& operator=(const Graph&) = delete;
 
         void Construction();
         void ConstructionTarjan();
@@ -30,15 +34,25 @@ namespace MSCSC {
         void BatchDeletion(vector<pair<int, int>>& edgeList);
         void BatchInsertion(vector<pair<int, int>>& edgeList);
 
+        int AddVertex(); // an isolated vertex, removed ids are given out again
+        void RemoveVertex(int u); // all in- and out-edges of u go in one BatchDeletion
+
+        // can u reach v in the current graph
+        bool Reachable(int u, int v);
+
         void Init();
         void Info();
 
+        // checkpoint of the whole index, Load is used on a default-constructed Graph
+        void Save(string filePath);
+        void Load(string filePath);
+
     public:
         // tarjan
-        Tarjan* tarjan;
+        Tarjan* tarjan = nullptr;
 
         // two hop
-        ReducedGraph* reducedGraph;
+        ReducedGraph* reducedGraph = nullptr;
 
         Timer::Timer myTimer;
 
@@ -51,5 +65,10 @@ namespace MSCSC {
 
         int sccMergeNum = 0;
 
+    private:
+        // outputs of the updates, filled in place so their buffers are reused
+        IncOutput incOutput_;
+        DecOutput decOutput_;
+        vector<DecOutput> decOutputList_;
     };
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+    // run func(threadID) for threadID in [0, threadNum) and wait for all of them
+    template <typename Func>
+    void Run(int threadNum, Func func) {
+        std::vector<std::thread> threadList;
+        threadList.reserve(threadNum);
+
+        for (int i=0;i<threadNum;i++) {
+            threadList.emplace_back(func, i);
+        }
+
+        for (auto& t : threadList) {
+            t.join();
+        }
+    }
+
+    // split [begin, end) into threadNum contiguous ranges and run func(i) for every i
+    template <typename Func>
+    void For(int threadNum, long long begin, long long end, Func func) {
+        Run(threadNum, [&](int id) {
+            long long rangeBegin = begin + (end - begin) * id / threadNum;
+            long long rangeEnd = begin + (end - begin) * (id + 1) / threadNum;
+
+            for (long long i=rangeBegin;i<rangeEnd;i++) {
+                func(i);
+            }
+        });
+    }
+
+}
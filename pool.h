@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Pool {
+
+    // slab allocator with a free list; objects still alive when the pool is destroyed are not destructed
+    template <typename T>
+    class ObjectPool {
+    public:
+        union Slot {
+            Slot* next;
+            alignas(T) unsigned char data[sizeof(T)];
+        };
+
+        explicit ObjectPool(size_t slabSize = 4096) : slabSize(slabSize) {}
+
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        template <typename... Args>
+        T* New(Args&&... args) {
+            if (!freeList) {
+                Grow();
+            }
+
+            Slot* slot = freeList;
+            freeList = slot->next;
+
+            return new (slot->data) T(std::forward<Args>(args)...);
+        }
+
+        void Delete(T* object) {
+            object->~T();
+
+            Slot* slot = reinterpret_cast<Slot*>(object);
+            slot->next = freeList;
+            freeList = slot;
+        }
+
+    private:
+        void Grow() {
+            Slot* slab = AddSlab(slabSize);
+            for (size_t i=0;i<slabSize;i++) {
+                slab[i].next = (i + 1 < slabSize) ? &slab[i+1] : freeList;
+            }
+            freeList = slab;
+        }
+
+        Slot* AddSlab(size_t count) {
+            slabList.emplace_back(new Slot[count]);
+            return slabList.back().get();
+        }
+
+    private:
+        size_t slabSize;
+        Slot* freeList = nullptr;
+        std::vector<std::unique_ptr<Slot[]>> slabList;
+    };
+
+}
@@ -1,4 +1,6 @@
 #include "tarjan.h"
+#include "parallel.h"
+#include "binaryio.h"
 
 #include <iostream>
 #include <stack>
@@ -6,51 +8,431 @@
 #include <cmath>
 #include <string>
 #include <algorithm>
-#include <numeric>
-#include <unordered_set>
+#include <cstring>
+#include <atomic>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 namespace MSCSC {
     Tarjan::Tarjan(string filePath) {
         Load(filePath);
+        BuildIn();
+        internalNum.assign(n+1, 0); // no edge is internal before the sccs are built
+        removedVertex.assign(n+1, 0);
 
-        extendN = (n + 2) / 2;
-        sccMap.resize(n+1+extendN, -1);
-        invSCCMap.resize(n+1+extendN);
+        extendN = 0;
+        sccMap.assign(n+1, -1); // sccMap[i] = -1 for i in [0, n] and 0 for the scc ids
+        internalEdgeNum.assign(n+1, 0);
+        necEdgeNumMap.assign(n+1, 0);
+        GrowSCCID((n + 2) / 2);
+
+        ResizeScratch();
+    }
 
-        vector<int> tmp(extendN);
-        iota(tmp.begin(), tmp.end(), n+1);
-        emptyNode = priority_queue<int, vector<int>, greater<int>>(tmp.begin(), tmp.end());
+    void Tarjan::BuildIn() {
+        vector<int> inDegree(n+1, 0);
+        for (int u=0;u<=n;u++) {
+            for (auto edge : G[u]) {
+                inDegree[edges.t[edge]]++;
+            }
+        }
+
+        GIn.assign(n+1, {});
+        for (int v=0;v<=n;v++) {
+            GIn[v].reserve(inDegree[v]);
+        }
 
-        for (int i=n+1;i<sccMap.size();i++) { // sccMap[i] = -1 for i in [0, n] and 0 otherwise
-            sccMap[i] = 0;
+        for (int u=0;u<=n;u++) {
+            for (auto edge : G[u]) {
+                auto& inList = GIn[edges.t[edge]];
+                edges.inIndex[edge] = inList.size();
+                inList.emplace_back(edge);
+            }
         }
+    }
 
+    void Tarjan::ResizeScratch() {
         inStack_.resize(n+1, 0);
         dfn_.resize(n+1, 0);
         low_.resize(n+1, 0);
         visited_.reserve(n+1);
+
+        visitStamp_.resize(n+1, 0);
+
+        batchSeen_.resize(n+1, 0);
+        batchVisit_.resize(n+1, 0);
+        batchNext_.resize(n+1, 0);
+        batchTouched_.reserve(n+1);
     }
 
-    void Tarjan::Load(string filePath) {
-        FILE *fileInput = nullptr;
+    // skip non-digit characters and parse the next unsigned integer; return nullptr if there is none
+    static inline const char* ParseInt(const char* p, const char* end, unsigned long long& x) {
+        while (p < end && (*p < '0' || *p > '9')) {
+            p++;
+        }
+
+        if (p == end) {
+            return nullptr;
+        }
 
-        fileInput = fopen(filePath.c_str(), "r");
-        if (!fileInput) {
+        x = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            x = x * 10 + (*p - '0');
+            p++;
+        }
+
+        return p;
+    }
+
+    void Tarjan::Load(string filePath) {
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
             printf("can not open file\n");
             exit(30);
         }
 
-        fscanf(fileInput, "%d%llu", &n, &m);
+        struct stat fileStat;
+        fstat(fd, &fileStat);
+        size_t fileSize = fileStat.st_size;
+
+        char* buffer = nullptr;
+        if (fileSize) {
+            buffer = (char*) mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (buffer == MAP_FAILED) {
+                printf("can not map file\n");
+                exit(30);
+            }
+            madvise(buffer, fileSize, MADV_SEQUENTIAL);
+        }
+        close(fd);
+
+        if (fileSize >= sizeof(CSRHeader) && memcmp(buffer, CSR_MAGIC, sizeof(CSRHeader::magic)) == 0) {
+            LoadBinary(buffer, fileSize);
+        } else {
+            LoadText(buffer, fileSize);
+        }
+
+        if (buffer) {
+            munmap(buffer, fileSize);
+        }
+    }
+
+    void Tarjan::LoadText(const char* buffer, size_t fileSize) {
+        const char* fileEnd = buffer + fileSize;
+        unsigned long long header[2] = {0, 0};
+        const char* body = buffer;
+        for (auto& x : header) {
+            body = body ? ParseInt(body, fileEnd, x) : nullptr;
+        }
+        if (!body || header[0] >= INT_MAX) {
+            printf("can not read graph header\n");
+            exit(30);
+        }
+
+        n = header[0];
+        m = header[1];
+        G.resize(n+1);
+
+        // split the edge list into THREAD_NUM chunks, each one starts at the beginning of a line
+        vector<const char*> chunk(THREAD_NUM + 1);
+        for (int i=0;i<=THREAD_NUM;i++) {
+            const char* p = body + (fileEnd - body) * i / THREAD_NUM;
+            while (i > 0 && p < fileEnd && *(p - 1) != '\n') {
+                p++;
+            }
+            chunk[i] = p;
+        }
+
+        // first pass: count out-degree of each node in each chunk
+        vector<vector<int>> cursor(THREAD_NUM);
+        vector<size_t> chunkEdgeNum(THREAD_NUM, 0);
+        atomic<bool> outOfRange(false);
+        Parallel::Run(THREAD_NUM, [&](int id) {
+            auto& degree = cursor[id];
+            degree.resize(n+1, 0);
+
+            unsigned long long u, v;
+            const char* p = chunk[id];
+            while ((p = ParseInt(p, chunk[id+1], u)) && (p = ParseInt(p, chunk[id+1], v))) {
+                if (u > (unsigned long long) n || v > (unsigned long long) n) {
+                    outOfRange.store(true, memory_order_relaxed);
+                    break;
+                }
+                degree[u]++;
+                chunkEdgeNum[id]++;
+            }
+        });
+
+        size_t edgeNum = 0;
+        for (auto num : chunkEdgeNum) {
+            edgeNum += num;
+        }
+        if (outOfRange.load() || edgeNum >= INT_MAX) { // an edge is an int index into the store
+            printf("graph file is corrupted\n");
+            exit(30);
+        }
+
+        // turn the counts into per-chunk write positions, so G[u] keeps the file order
+        Parallel::Run(THREAD_NUM, [&](int id) {
+            for (int u=id;u<=n;u+=THREAD_NUM) {
+                int total = 0;
+                for (auto& degree : cursor) {
+                    int tmp = degree[u];
+                    degree[u] = total;
+                    total += tmp;
+                }
+                G[u].resize(total);
+            }
+        });
+
+        // second pass: fill each G[u], each chunk takes its edges from its own range of the store
+        vector<int> first(THREAD_NUM);
+        m = 0;
+        for (int i=0;i<THREAD_NUM;i++) {
+            first[i] = edges.Append(chunkEdgeNum[i]);
+            m += chunkEdgeNum[i];
+        }
+
+        Parallel::Run(THREAD_NUM, [&](int id) {
+            auto& position = cursor[id];
+            int edge = first[id];
+
+            unsigned long long u, v;
+            const char* p = chunk[id];
+            while ((p = ParseInt(p, chunk[id+1], u)) && (p = ParseInt(p, chunk[id+1], v))) { // no multiple edge between two nodes
+                edges.Set(edge, u, v);
+                G[u][position[u]++] = edge++;
+            }
+        });
+    }
+
+    void Tarjan::LoadBinary(const char* buffer, size_t fileSize) {
+        auto header = (const CSRHeader*) buffer;
+        if (header->version != CSR_VERSION) {
+            printf("unsupported binary graph version\n");
+            exit(30);
+        }
+
+        if (header->n < 0 || header->n >= INT_MAX || header->m >= INT_MAX) { // an edge is an int index into the store
+            printf("binary graph file is corrupted\n");
+            exit(30);
+        }
+
+        n = header->n;
+        m = header->m;
+
+        // layout: header | offset[0..n+1] | target[0..m-1]
+        auto offset = (const unsigned long long*) (buffer + sizeof(CSRHeader));
+        auto target = (const int*) (offset + n + 2);
+        if (fileSize < sizeof(CSRHeader) + ((size_t) n + 2) * sizeof(unsigned long long) + (size_t) m * sizeof(int) || offset[n+1] != m) {
+            printf("binary graph file is truncated\n");
+            exit(30);
+        }
+
+        // nothing is trusted before it indexes G: offsets from 0 to m without going back, targets in [0, n]
+        bool valid = offset[0] == 0;
+        for (int u=0;u<=n&&valid;u++) {
+            valid = offset[u] <= offset[u+1];
+        }
+
+        atomic<bool> outOfRange(false);
+        if (valid) {
+            Parallel::Run(THREAD_NUM, [&](int id) {
+                for (long long i=(long long) m*id/THREAD_NUM;i<(long long) m*(id+1)/THREAD_NUM;i++) {
+                    if (target[i] < 0 || target[i] > n) {
+                        outOfRange.store(true, memory_order_relaxed);
+                        break;
+                    }
+                }
+            });
+        }
+
+        if (!valid || outOfRange.load()) {
+            printf("binary graph file is corrupted\n");
+            exit(30);
+        }
+
         G.resize(n+1);
 
-        // read graph file
-        int u, v;
-        while (fscanf(fileInput, "%d%d", &u, &v) == 2) { // no multiple edge between two nodes
-            auto edge = new EdgeNode(u, v);
-            G[u].emplace_back(edge);
+        // edge i of the file is edge i of the store, each thread fills a contiguous range of nodes
+        vector<int> begin(THREAD_NUM + 1);
+        for (int i=0;i<=THREAD_NUM;i++) {
+            begin[i] = (long long) (n + 1) * i / THREAD_NUM;
+        }
+        edges.Append(m);
+
+        Parallel::Run(THREAD_NUM, [&](int id) {
+            for (int u=begin[id];u<begin[id+1];u++) {
+                G[u].reserve(offset[u+1] - offset[u]);
+                for (auto i=offset[u];i<offset[u+1];i++) {
+                    edges.Set(i, u, target[i]);
+                    G[u].emplace_back(i);
+                }
+            }
+        });
+    }
+
+    void Tarjan::SaveBinary(string filePath) {
+        FILE *fileOutput = fopen(filePath.c_str(), "wb");
+        if (!fileOutput) {
+            printf("can not open file\n");
+            exit(30);
+        }
+
+        CSRHeader header;
+        memcpy(header.magic, CSR_MAGIC, sizeof(header.magic));
+        header.version = CSR_VERSION;
+        header.n = n;
+        header.m = 0;
+        for (auto& edgeList : G) {
+            header.m += edgeList.size();
+        }
+        fwrite(&header, sizeof(header), 1, fileOutput);
+
+        unsigned long long offset = 0;
+        for (int u=0;u<=n;u++) {
+            fwrite(&offset, sizeof(offset), 1, fileOutput);
+            offset += G[u].size();
+        }
+        fwrite(&offset, sizeof(offset), 1, fileOutput);
+
+        vector<int> target;
+        for (auto& edgeList : G) {
+            target.clear();
+            for (auto edge : edgeList) {
+                target.emplace_back(edges.t[edge]);
+            }
+            fwrite(target.data(), sizeof(int), target.size(), fileOutput);
+        }
+
+        fclose(fileOutput);
+    }
+
+    void Tarjan::Serialize(FILE* file) {
+        BinaryIO::WriteValue(file, n);
+        BinaryIO::WriteValue(file, extendN);
+        BinaryIO::WriteValue(file, m);
+
+        // graph with the needed/internal flag of each edge
+        vector<int> target;
+        vector<char> flag;
+        for (auto& edgeList : G) {
+            target.clear();
+            flag.clear();
+            for (auto edge : edgeList) {
+                target.emplace_back(edges.t[edge]);
+                flag.emplace_back(edges.flag[edge]);
+            }
+            BinaryIO::WriteVector(file, target);
+            BinaryIO::WriteVector(file, flag);
+        }
+
+        // scc node
+        BinaryIO::WriteVector(file, sccMap);
+
+        int sccNum = 0;
+        for (auto& nodeList : invSCCMap) {
+            sccNum += !nodeList.empty();
+        }
+        BinaryIO::WriteValue(file, sccNum);
+        for (int i=0;i<(int) invSCCMap.size();i++) {
+            if (!invSCCMap[i].empty()) {
+                BinaryIO::WriteValue(file, i);
+                BinaryIO::WriteVector(file, invSCCMap[i]);
+            }
+        }
+
+        BinaryIO::WriteVector(file, necEdgeNumMap);
+
+        BinaryIO::WriteVector(file, emptyNode);
+        BinaryIO::WriteVector(file, emptyVertex);
+    }
+
+    void Tarjan::Deserialize(FILE* file) {
+        BinaryIO::ReadValue(file, n);
+        BinaryIO::ReadValue(file, extendN);
+        BinaryIO::ReadValue(file, m);
+        BinaryIO::Check(n >= 0 && n < INT_MAX && extendN >= 0 && extendN < INT_MAX - n);
+
+        // G grows as the lists are read, a corrupted n fails at the end of the file
+        G.clear();
+        internalNum.clear();
+        vector<int> target;
+        vector<char> flag;
+        unsigned long long edgeNum = 0;
+        for (int u=0;u<=n;u++) {
+            BinaryIO::ReadVector(file, target);
+            BinaryIO::ReadVector(file, flag);
+            BinaryIO::Check(target.size() == flag.size());
+
+            G.emplace_back();
+            internalNum.emplace_back(0);
+            G[u].reserve(target.size());
+            edgeNum += target.size();
+            for (int i=0;i<(int) target.size();i++) {
+                BinaryIO::Check(target[i] >= 0 && target[i] <= n);
+
+                auto edge = edges.New(u, target[i]);
+                edges.flag[edge] = flag[i] & (EDGE_NEEDED | EDGE_INTERNAL);
+                G[u].emplace_back(edge);
+            }
+            PartitionEdges(u);
+        }
+        BinaryIO::Check(edgeNum == m);
+
+        BinaryIO::ReadVector(file, sccMap);
+        BinaryIO::Check(sccMap.size() == (size_t) (n+1+extendN));
+        for (int u=0;u<(int) sccMap.size();u++) { // a node is single or points at an scc id holding its negative size
+            int id = sccMap[u];
+            BinaryIO::Check(u <= n ? id == -1 || (id > n && id < (int) sccMap.size() && sccMap[id] < 0) : id <= 0);
         }
-        fclose(fileInput);
+
+        // every node is listed exactly once, under its own scc, and each list is as long as its scc
+        int sccNum;
+        BinaryIO::ReadValue(file, sccNum);
+        BinaryIO::Check(sccNum >= 0 && sccNum <= (int) sccMap.size());
+        invSCCMap.resize(n+1+extendN);
+        vector<char> listed(n+1, 0);
+        int listedNum = 0;
+        for (int i=0;i<sccNum;i++) {
+            int id;
+            BinaryIO::ReadValue(file, id);
+            BinaryIO::Check(id >= 0 && id < (int) invSCCMap.size() && invSCCMap[id].empty());
+            BinaryIO::ReadVector(file, invSCCMap[id]);
+            BinaryIO::Check((int) invSCCMap[id].size() == (id <= n ? 1 : -sccMap[id]));
+            for (auto x : invSCCMap[id]) {
+                BinaryIO::Check(x >= 0 && x <= n && !listed[x] && Find(x) == id);
+                listed[x] = 1;
+            }
+            listedNum += invSCCMap[id].size();
+        }
+        BinaryIO::Check(listedNum == n+1);
+        for (int id=n+1;id<(int) sccMap.size();id++) {
+            BinaryIO::Check(sccMap[id] == 0 || !invSCCMap[id].empty());
+        }
+
+        BinaryIO::ReadVector(file, necEdgeNumMap);
+        BinaryIO::Check(necEdgeNumMap.size() == sccMap.size());
+
+        BinaryIO::ReadVector(file, emptyNode);
+        for (auto id : emptyNode) {
+            BinaryIO::Check(id > n && id < (int) sccMap.size() && !sccMap[id]);
+        }
+
+        BinaryIO::ReadVector(file, emptyVertex);
+        removedVertex.assign(n+1, 0);
+        for (auto u : emptyVertex) {
+            BinaryIO::Check(u >= 0 && u <= n && G[u].empty() && sccMap[u] == -1 && !removedVertex[u]);
+            removedVertex[u] = 1;
+        }
+
+        BuildIn();
+        CountInternalEdge();
+        ResizeScratch();
     }
 
     void Tarjan::Construction() {
@@ -72,75 +454,400 @@ namespace MSCSC {
         myTimer.EndTimerAndPrint("tarjan construction");
     }
 
+    void Tarjan::ParallelConstruction() {
+        myTimer.StartTimer("tarjan construction");
+
+        // 1. degrees, the in-edges are in GIn
+        vector<atomic<int>> inDegree(n+1);
+        vector<atomic<int>> outDegree(n+1);
+
+        Parallel::For(THREAD_NUM, 0, n+1, [&](long long u) {
+            inDegree[u].store(GIn[u].size(), memory_order_relaxed);
+            outDegree[u].store(G[u].size(), memory_order_relaxed);
+
+            for (auto edge : G[u]) {
+                edges.SetNeeded(edge, false);
+            }
+        });
+
+        // 2. trimming, a node without in-edges or out-edges among the remaining nodes is a single node scc
+        vector<atomic<char>> removed(n+1);
+
+        Parallel::Run(THREAD_NUM, [&](int id) {
+            vector<int> queue;
+            auto tryRemove = [&](int x) {
+                if (!removed[x].exchange(1)) {
+                    queue.emplace_back(x);
+                }
+            };
+
+            int rangeBegin = (long long) (n + 1) * id / THREAD_NUM;
+            int rangeEnd = (long long) (n + 1) * (id + 1) / THREAD_NUM;
+            for (int i=rangeBegin;i<rangeEnd;i++) {
+                if (inDegree[i].load() == 0 || outDegree[i].load() == 0) {
+                    tryRemove(i);
+                }
+            }
+
+            while (!queue.empty()) {
+                int x = queue.back();
+                queue.pop_back();
+
+                for (auto edge : G[x]) {
+                    if (inDegree[edges.t[edge]].fetch_sub(1) == 1) {
+                        tryRemove(edges.t[edge]);
+                    }
+                }
+
+                for (auto edge : GIn[x]) {
+                    if (outDegree[edges.s[edge]].fetch_sub(1) == 1) {
+                        tryRemove(edges.s[edge]);
+                    }
+                }
+            }
+        });
+
+        // 3. forward-backward search from the pivot finds the (usually giant) scc of the pivot
+        enum { PART_TRIMMED, PART_PIVOT, PART_FORWARD, PART_BACKWARD, PART_REST };
+
+        vector<char> part(n+1, PART_TRIMMED);
+        vector<vector<int>> sccList;
+
+        int pivot = -1;
+        long long pivotDegree = -1;
+        for (int i=0;i<=n;i++) {
+            if (!removed[i].load(memory_order_relaxed)) {
+                long long degree = (long long) inDegree[i].load(memory_order_relaxed) * outDegree[i].load(memory_order_relaxed);
+                if (degree > pivotDegree) {
+                    pivot = i;
+                    pivotDegree = degree;
+                }
+            }
+        }
+
+        if (pivot != -1) {
+            vector<atomic<int>> forwardLevel(n+1);
+            vector<atomic<int>> backwardLevel(n+1);
+
+            // level synchronous bfs over the remaining nodes, big frontiers are expanded by all threads
+            auto bfs = [&](vector<atomic<int>>& level, bool forward) {
+                for (int i=0;i<=n;i++) {
+                    level[i].store(-1, memory_order_relaxed);
+                }
+
+                vector<int> frontier = {pivot};
+                level[pivot].store(0, memory_order_relaxed);
+
+                for (int depth=1;!frontier.empty();depth++) {
+                    vector<vector<int>> next(THREAD_NUM);
+
+                    auto visit = [&](int id, int x) {
+                        int expect = -1;
+                        if (!removed[x].load(memory_order_relaxed) && level[x].load(memory_order_relaxed) == -1 && level[x].compare_exchange_strong(expect, depth)) {
+                            next[id].emplace_back(x);
+                        }
+                    };
+
+                    auto expand = [&](int id, size_t rangeBegin, size_t rangeEnd) {
+                        for (size_t i=rangeBegin;i<rangeEnd;i++) {
+                            int x = frontier[i];
+                            if (forward) {
+                                for (auto edge : G[x]) {
+                                    visit(id, edges.t[edge]);
+                                }
+                            } else {
+                                for (auto edge : GIn[x]) {
+                                    visit(id, edges.s[edge]);
+                                }
+                            }
+                        }
+                    };
+
+                    if (frontier.size() < PARALLEL_FRONTIER_THRESHOLD) {
+                        expand(0, 0, frontier.size());
+                    } else {
+                        Parallel::Run(THREAD_NUM, [&](int id) {
+                            expand(id, frontier.size() * id / THREAD_NUM, frontier.size() * (id + 1) / THREAD_NUM);
+                        });
+                    }
+
+                    frontier.clear();
+                    for (auto& list : next) {
+                        frontier.insert(frontier.end(), list.begin(), list.end());
+                    }
+                }
+            };
+
+            bfs(forwardLevel, true);
+            bfs(backwardLevel, false);
+
+            Parallel::For(THREAD_NUM, 0, n+1, [&](long long i) {
+                if (removed[i].load(memory_order_relaxed)) {
+                    return;
+                }
+
+                bool reached = forwardLevel[i].load(memory_order_relaxed) != -1;
+                bool reaching = backwardLevel[i].load(memory_order_relaxed) != -1;
+                if (reached && reaching) {
+                    part[i] = PART_PIVOT;
+                } else if (reached) {
+                    part[i] = PART_FORWARD;
+                } else if (reaching) {
+                    part[i] = PART_BACKWARD;
+                } else {
+                    part[i] = PART_REST;
+                }
+            });
+
+            // needed edges of the pivot scc: a bfs in-tree and a bfs out-tree of the pivot
+            // the parent of every node is the in-edge with the smallest source and the first out-edge, so the result does not depend on the threads
+            Parallel::For(THREAD_NUM, 0, n+1, [&](long long i) {
+                if (part[i] != PART_PIVOT || i == pivot) {
+                    return;
+                }
+
+                int level = forwardLevel[i].load(memory_order_relaxed);
+                int parentEdge = -1;
+                for (auto edge : GIn[i]) {
+                    int s = edges.s[edge];
+                    if (part[s] == PART_PIVOT && forwardLevel[s].load(memory_order_relaxed) == level - 1 && (parentEdge == -1 || s < edges.s[parentEdge])) {
+                        parentEdge = edge;
+                    }
+                }
+                edges.SetNeeded(parentEdge, true);
+            });
+
+            Parallel::For(THREAD_NUM, 0, n+1, [&](long long i) {
+                if (part[i] != PART_PIVOT || i == pivot) {
+                    return;
+                }
+
+                int level = backwardLevel[i].load(memory_order_relaxed);
+                int parentEdge = -1;
+                for (auto edge : G[i]) {
+                    if (part[edges.t[edge]] == PART_PIVOT && backwardLevel[edges.t[edge]].load(memory_order_relaxed) == level - 1) {
+                        if (parentEdge == -1 || edges.Needed(edge)) { // prefer an edge of the out-tree
+                            parentEdge = edge;
+                        }
+                        if (edges.Needed(edge)) {
+                            break;
+                        }
+                    }
+                }
+                edges.SetNeeded(parentEdge, true);
+            });
+
+            sccList.emplace_back();
+            for (int i=0;i<=n;i++) {
+                if (part[i] == PART_PIVOT) {
+                    sccList.back().emplace_back(i);
+                }
+            }
+        }
+
+        // 4. no scc crosses the three remaining parts, each one is finished by a sequential tarjan
+        {
+            vector<int> dfn(n+1, 0);
+            vector<int> low(n+1, 0);
+            vector<char> inStack(n+1, 0);
+            vector<vector<vector<int>>> partSCCList(3);
+
+            Parallel::Run(3, [&](int id) {
+                BuildPart(part, PART_FORWARD + id, dfn, low, inStack, partSCCList[id]);
+            });
+
+            for (auto& list : partSCCList) {
+                for (auto& nodeList : list) {
+                    sccList.emplace_back(move(nodeList));
+                }
+            }
+        }
+
+        // 5. scc ids are given in a fixed order
+        for (auto& nodeList : sccList) {
+            if (nodeList.size() < 2) {
+                continue;
+            }
+
+            int newNode = NewSCCID();
+
+            for (int x : nodeList) {
+                sccMap[x] = newNode;
+            }
+            sccMap[newNode] = -(int) nodeList.size();
+        }
+
+        for (int i=0;i<=n;i++) {
+            invSCCMap[Find(i)].emplace_back(i);
+        }
+
+        myTimer.EndTimerAndPrint("tarjan construction");
+    }
+
+    void Tarjan::BuildPart(const vector<char>& part, char label, vector<int>& dfn, vector<int>& low, vector<char>& inStack, vector<vector<int>>& sccList) {
+        int dfnNum = 0;
+        vector<int> dfsStack;
+        vector<EdgeFrame> frame;
+
+        auto enter = [&](int x) {
+            dfn[x] = low[x] = ++dfnNum;
+            dfsStack.emplace_back(x);
+            inStack[x] = 1;
+            frame.push_back({x, 0, -1});
+        };
+
+        for (int u=0;u<=n;u++) {
+            if (part[u] != label || dfn[u]) {
+                continue;
+            }
+
+            enter(u);
+
+            while (!frame.empty()) {
+                auto& now = frame.back();
+                int x = now.u;
+
+                if (now.index < (int) G[x].size()) {
+                    auto edge = G[x][now.index++];
+                    int v = edges.t[edge];
+                    if (part[v] != label) { // edges leaving the part are never in an scc
+                        continue;
+                    }
+
+                    if (!dfn[v]) {
+                        edges.SetNeeded(edge, true); // tree edge
+                        enter(v);
+                    } else if (inStack[v] && low[x] > dfn[v]) {
+                        now.lastDrop = edge;
+                        low[x] = dfn[v];
+                    }
+                    continue;
+                }
+
+                if (now.lastDrop != -1) {
+                    edges.SetNeeded(now.lastDrop, true);
+                }
+
+                if (low[x] == dfn[x]) {
+                    vector<int> nodeList;
+                    while (true) {
+                        int y = dfsStack.back();
+                        dfsStack.pop_back();
+                        inStack[y] = 0;
+                        nodeList.emplace_back(y);
+                        if (y == x) {
+                            break;
+                        }
+                    }
+
+                    if (nodeList.size() > 1) {
+                        sccList.emplace_back(move(nodeList));
+                    }
+                }
+
+                frame.pop_back();
+
+                if (!frame.empty()) {
+                    auto& parent = frame.back();
+                    if (low[x] <= low[parent.u]) {
+                        parent.lastDrop = G[parent.u][parent.index-1];
+                        low[parent.u] = low[x];
+                    }
+                }
+            }
+        }
+    }
+
     void Tarjan::Build(int u, Args& args) {
+        BuildFrom(u, args, false);
+    }
+
+    void Tarjan::BuildFrom(int u, Args& args, bool internalOnly) {
         auto& dfn = args.dfn;
         auto& low = args.low;
         auto& dfnNum = args.dfnNum;
         auto& dfsStack = args.dfsStack;
         auto& inStack = args.inStack;
         auto& visited = args.visited;
+        auto& frame = args.edgeFrame;
+
+        auto enter = [&](int x) {
+            visited.emplace_back(x);
+            dfn[x] = low[x] = ++dfnNum;
+            dfsStack.emplace_back(x);
+            inStack[x] = 1;
+            frame.push_back({x, 0, -1});
+        };
+
+        enter(u);
+
+        while (!frame.empty()) {
+            auto& now = frame.back();
+            int x = now.u;
+
+            if (now.index < (internalOnly ? internalNum[x] : (int) G[x].size())) { // the internal segment holds the edges in this SCC
+                auto edge = G[x][now.index++];
+                edges.SetNeeded(edge, false);
+                int v = edges.t[edge];
+
+                if (!dfn[v]) {
+                    edges.SetNeeded(edge, true); // tree edge
+                    enter(v);
+                } else if (inStack[v] && low[x] > dfn[v]) {
+                    now.lastDrop = edge;
+                    low[x] = dfn[v];
+                }
+                continue;
+            }
 
-        visited.emplace_back(u);
-        dfn[u] = low[u] = ++dfnNum;
-        dfsStack.push(u);
-        inStack[u] = 1;
-        EdgeNode* lastDrop = nullptr;
+            // all edges of x are done
+            if (now.lastDrop != -1) { // before return, update the last dropping edge
+                edges.SetNeeded(now.lastDrop, true);
+            }
 
-        for (auto edge : G[u]) {
-            edge->needed = false;
-            int v = edge->t;
+            if (low[x] == dfn[x]) {
+                CreateSCC(x, dfsStack, inStack);
+            }
 
-            if (!dfn[v]) {
-                edge->needed = true; // tree edge
-                Build(v, args);
+            frame.pop_back();
 
-                if (low[v] <= low[u]) {
-                    lastDrop = edge;
-                    low[u] = low[v];
+            if (!frame.empty()) { // back to the parent through the tree edge
+                auto& parent = frame.back();
+                if (low[x] <= low[parent.u]) {
+                    parent.lastDrop = G[parent.u][parent.index-1];
+                    low[parent.u] = low[x];
                 }
-            } else if (inStack[v] && low[u] > dfn[v]) {
-                lastDrop = edge;
-                low[u] = dfn[v];
             }
         }
-
-        if (lastDrop) { // before return, update the last dropping edge
-            lastDrop->needed = true;
-        }
-
-        if (low[u] == dfn[u]) {
-            CreateSCC(u, dfsStack, inStack);
-        }
     }
 
-    void Tarjan::CreateSCC(int root, stack<int>& dfsStack, vector<int>& inStack) {
+    void Tarjan::CreateSCC(int root, vector<int>& dfsStack, vector<int>& inStack) {
         int newNode = -1;
-        if (dfsStack.top() != root) { // form an SCC with at least two nodes
-            newNode = emptyNode.top();
-            emptyNode.pop();
+        if (dfsStack.back() != root) { // form an SCC with at least two nodes
+            newNode = NewSCCID();
         }
 
-        while (dfsStack.top() != root) {
-            sccMap[dfsStack.top()] = newNode;
+        while (dfsStack.back() != root) {
+            sccMap[dfsStack.back()] = newNode;
             sccMap[newNode]--;
-            inStack[dfsStack.top()] = 0;
-            dfsStack.pop();
+            inStack[dfsStack.back()] = 0;
+            dfsStack.pop_back();
         }
 
         inStack[root] = 0;
-        dfsStack.pop(); // s[tail] = u
+        dfsStack.pop_back(); // s[tail] = u
         if (newNode != -1) {
             sccMap[root] = newNode;
             sccMap[newNode]--;
         }
     }
 
-    void Tarjan::InsertionSCC(EdgeNode* newEdge, IncOutput& output) {
+    void Tarjan::InsertionSCC(int newEdge, IncOutput& output) {
         if (output.affNode.empty()) {
             return;
         }
 
-        newEdge->needed = true;
+        edges.SetNeeded(newEdge, true);
 
         InsertionManageSCCNode(output);
     }
@@ -170,27 +877,27 @@ namespace MSCSC {
                 maxSize = -sccMap[i];
                 maxID = i;
             }
-            necEdgeSize += (-sccMap[i]); // sum of necEdgeNum for each SCC
+            necEdgeSize += necEdgeNumMap[i]; // sum of necEdgeNum for each SCC, 0 for a single node
         }
 
         necEdgeSize += output.necEdge.size(); // new necEdge
 
         // mark arbitrary one of the superEdge's subEdge as necessary
         for (auto i : output.necEdge) {
-            auto it = i->subEdge.begin();
-            (*it)->needed = true;
+            edges.SetNeeded(i->subEdge.front(), true);
         }
 
         // maxSize == 1 means every node is a single node, then we need to allocate a new scc node
         if (maxSize == 1) {
-            maxID = emptyNode.top();
-            emptyNode.pop();
+            maxID = NewSCCID();
+            internalEdgeNum[maxID] = 0;
         }
 
         // merge ssc nodes into the biggest scc node
         for (auto i : output.affNode) {
             if (i != maxID) {
                 sccMap[maxID] += sccMap[i]; // change size
+                internalEdgeNum[maxID] += internalEdgeNum[i];
                 for (auto node : invSCCMap[i]) {
                     sccMap[node] = maxID; // change relation
                 }
@@ -198,7 +905,7 @@ namespace MSCSC {
                 invSCCMap[i].clear();
                 if (i > n) {
                     sccMap[i] = 0;
-                    emptyNode.emplace(i);
+                    FreeSCCID(i);
                 }
             }
         }
@@ -208,8 +915,10 @@ namespace MSCSC {
         necEdgeNumMap[maxID] = necEdgeSize;
 
         // if it is an exsiting node, then rm it
-        if (output.affNode.find(output.finalID) != output.affNode.end()) {
-            output.affNode.erase(output.finalID);
+        auto it = find(output.affNode.begin(), output.affNode.end(), output.finalID);
+        if (it != output.affNode.end()) {
+            *it = output.affNode.back();
+            output.affNode.pop_back();
         } 
     }
 
@@ -220,144 +929,372 @@ namespace MSCSC {
         auto& dfsStack = args.dfsStack;
         auto& inStack = args.inStack;
         auto& visited = args.visited;
+        auto& frame = args.edgeFrame;
 
-        if (u == target) {
-            if (necEdgeNum + prevLastDropNum > threshold) {
-                redo = true; // redo, indicate the necEdgeNum is above the 2-approximation
-            } else {
-                return true;
+        // return true when reaching target with the necEdgeNum below threshold
+        auto reach = [&](int x) {
+            if (x == target) {
+                if (necEdgeNum + prevLastDropNum > threshold) {
+                    redo = true; // redo, indicate the necEdgeNum is above the 2-approximation
+                } else {
+                    return true;
+                }
             }
+            return false;
+        };
+
+        auto enter = [&](int x) {
+            visited.emplace_back(x);
+            dfn[x] = low[x] = ++dfnNum;
+            dfsStack.emplace_back(x);
+            inStack[x] = 1;
+            frame.push_back({x, 0, -1});
+        };
+
+        if (reach(u)) {
+            return true;
         }
+        enter(u);
+
+        while (!frame.empty()) {
+            auto& now = frame.back();
+            int x = now.u;
+
+            if (now.index < internalNum[x]) { // edges in this SCC
+                auto edge = G[x][now.index++];
+                necEdgeNum -= edges.Needed(edge);
+                edges.SetNeeded(edge, false); // need to mark it false at first
+                int v = edges.t[edge];
+
+                if (!dfn[v]) {
+                    necEdgeNum++;
+                    edges.SetNeeded(edge, true);
+
+                    // return true only when the first time meet target, and the necNum is smaller than threshold
+                    prevLastDropNum =+ ((now.lastDrop!=-1&&!edges.Needed(now.lastDrop)) ? 1 : 0);
+
+                    if (reach(v)) {
+                        // every node on the path updates its last dropping edge before return
+                        for (auto& f : frame) {
+                            if (f.lastDrop != -1) {
+                                necEdgeNum += (1 - edges.Needed(f.lastDrop));
+                                edges.SetNeeded(f.lastDrop, true);
+                            }
+                        }
+                        frame.clear();
+                        return true;
+                    }
 
-        visited.emplace_back(u);
-        dfn[u] = low[u] = ++dfnNum;
-        dfsStack.push(u);
-        inStack[u] = 1;
-        EdgeNode* lastDrop = nullptr;
-
-        for (auto edge : G[u]) {
-            if (!edge->internal) { // edges in this SCC
+                    enter(v);
+                } else if (inStack[v] && low[x] > dfn[v]) {
+                    now.lastDrop = edge;
+                    low[x] = dfn[v];
+                }
                 continue;
             }
 
-            necEdgeNum -= edge->needed;
-            edge->needed = false; // need to mark it false at first
-            int v = edge->t;
-
-            if (!dfn[v]) {
-                necEdgeNum++;
-                edge->needed = true;
+            // all edges of x are done
+            if (now.lastDrop != -1) { // before return, update the last dropping edge
+                necEdgeNum += (1 - edges.Needed(now.lastDrop));
+                edges.SetNeeded(now.lastDrop, true);
+            }
 
-                // return true only when the first time meet target, and the necNum is smaller than threshold
-                prevLastDropNum =+ ((lastDrop!=nullptr&&!lastDrop->needed) ? 1 : 0);
+            if (low[x] == dfn[x] && !redo) {
+                CreateSCC(x, dfsStack, inStack);
+            }
 
-                if (TryBuildInternal(v, target, args, redo, prevLastDropNum, threshold, necEdgeNum)) {
-                    if (lastDrop) { // before return, update the last dropping edge
-                        necEdgeNum += (1 - lastDrop->needed);
-                        lastDrop->needed = true;
-                    }
-                    return true;
-                }
+            frame.pop_back();
 
-                prevLastDropNum -= ((lastDrop!=nullptr&&!lastDrop->needed) ? 1 : 0);
+            if (!frame.empty()) { // back to the parent through the tree edge
+                auto& parent = frame.back();
+                prevLastDropNum -= ((parent.lastDrop!=-1&&!edges.Needed(parent.lastDrop)) ? 1 : 0);
 
-                if (low[v] <= low[u]) {
-                    lastDrop = edge;
-                    low[u] = low[v];
+                if (low[x] <= low[parent.u]) {
+                    parent.lastDrop = G[parent.u][parent.index-1];
+                    low[parent.u] = low[x];
                 }
-            } else if (inStack[v] && low[u] > dfn[v]) {
-                lastDrop = edge;
-                low[u] = dfn[v];
             }
         }
 
-        if (lastDrop) { // before return, update the last dropping edge
-            necEdgeNum += (1 - lastDrop->needed);
-            lastDrop->needed = true;
-        }
-
-        if (low[u] == dfn[u] && !redo) {
-            CreateSCC(u, dfsStack, inStack);
-        }
-
         return false;
     }
 
-    void Tarjan::BuildInternal(int u, Args& args) {
+    bool Tarjan::TryBuildInternal(const vector<pair<int, int>>& edgeList, Args& args, int& necEdgeNum, SplitResult& result) {
+        // the old needed edges connect the scc, so it stays connected iff every u still reaches its v,
+        // and then the u -> v paths take the place of the deleted edges
+        // scratch: dfn = stamp of the current bfs
         auto& dfn = args.dfn;
-        auto& low = args.low;
-        auto& dfnNum = args.dfnNum;
-        auto& dfsStack = args.dfsStack;
-        auto& inStack = args.inStack;
         auto& visited = args.visited;
+        auto& queue = args.pathQueue;
 
-        visited.emplace_back(u);
-        dfn[u] = low[u] = ++dfnNum;
-        dfsStack.push(u);
-        inStack[u] = 1;
-        EdgeNode* lastDrop = nullptr;
+        // each search may scan 2 * |scc| / k edges, so a split found by the last search costs no more than the full tarjan
+        int sccSize = -sccMap[Find(edgeList.front().first)];
+        long long pairBudget = 2LL * sccSize / edgeList.size();
 
-        for (auto edge : G[u]) {
-            if (!edge->internal) { // edges in this SCC
-                continue;
+        necEdgeNum -= edgeList.size(); // the deleted edges were needed
+
+        for (int k=0;k<(int) edgeList.size();k++) {
+            auto [u, v] = edgeList[k];
+            int stamp = k + 1;
+
+            queue.clear();
+            queue.push_back({u, -1, -1});
+            dfn[u] = stamp;
+            visited.emplace_back(u);
+
+            int found = -1;
+            long long budget = pairBudget;
+            for (int head=0;head<(int) queue.size()&&found==-1;head++) {
+                if (budget < 0) { // a long detour, let the full tarjan decide
+                    result = SPLIT_TRY;
+                    return false;
+                }
+                int y = queue[head].u;
+                budget -= internalNum[y];
+
+                for (int i=0;i<internalNum[y];i++) {
+                    auto edge = G[y][i];
+                    int x = edges.t[edge];
+                    if (dfn[x] == stamp) {
+                        continue;
+                    }
+
+                    dfn[x] = stamp;
+                    visited.emplace_back(x);
+                    queue.push_back({x, head, edge});
+
+                    if (x == v) {
+                        found = queue.size() - 1;
+                        break;
+                    }
+                }
             }
 
-            edge->needed = false;
-            int v = edge->t;
-            
-            if (!dfn[v]) {
-                edge->needed = true;
-                BuildInternal(v, args);
+            if (found == -1) { // v is cut off from u
+                result = SPLIT_CUT;
+                return false;
+            }
+
+            for (int i=found;queue[i].edge!=-1;i=queue[i].parent) {
+                necEdgeNum += !edges.Needed(queue[i].edge);
+                edges.SetNeeded(queue[i].edge, true);
+            }
+        }
+
+        // the paths only add needed edges, past the 2-approximation the full tarjan builds them again
+        if (necEdgeNum > 2 * (sccSize - 1)) {
+            result = SPLIT_REDO;
+            return false;
+        }
+
+        return true;
+    }
+
+    void Tarjan::BuildInternal(int u, Args& args) {
+        BuildFrom(u, args, true);
+    }
+
+
+    void Tarjan::TrimSplit(const vector<int>& sccNodeList, Args& args, int threadNum) {
+        // a node without in-edges or out-edges among the nodes left is a single node scc,
+        // removing it may leave another one without, so peel until none is left
+        // the nodes already visited by tarjan are done and ignored here
+        // one thread pays about a quarter of the tarjan it may save, so it only runs with several threads
+        if (threadNum == 1 || (int) sccNodeList.size() < SPLIT_TRIM_THRESHOLD) {
+            return;
+        }
+
+        auto& dfn = args.dfn;
+        auto& low = args.low;
+        auto& dfnNum = args.dfnNum;
+        auto& visited = args.visited;
+
+        // scratch: low = position in nodeList
+        auto& nodeList = trimNode_;
+        nodeList.clear();
+        for (auto i : sccNodeList) {
+            if (!dfn[i]) {
+                low[i] = nodeList.size();
+                nodeList.emplace_back(i);
+            }
+        }
 
-                if (low[v] <= low[u]) {
-                    lastDrop = edge;
-                    low[u] = low[v];
+        int size = nodeList.size();
+        if (size < SPLIT_TRIM_THRESHOLD) {
+            return;
+        }
+
+        // the atomics can not be resized, they are replaced by larger ones
+        if ((int) trimInDegree_.size() < size) {
+            trimInDegree_ = vector<atomic<int>>(sccNodeList.size());
+            trimOutDegree_ = vector<atomic<int>>(sccNodeList.size());
+            trimRemoved_ = vector<atomic<char>>(sccNodeList.size());
+        }
+        if ((int) trimQueue_.size() < threadNum) {
+            trimQueue_.resize(threadNum);
+        }
+
+        // f(position) for every internal edge of x to a node left
+        auto forLeft = [&](int x, auto&& f) {
+            for (int j=0;j<internalNum[x];j++) {
+                int t = edges.t[G[x][j]];
+                if (!dfn[t]) {
+                    f(low[t]);
+                }
+            }
+        };
+
+        // f(position) for every internal edge of x from a node left, an internal edge comes from the same scc
+        auto forLeftIn = [&](int x, auto&& f) {
+            for (auto edge : GIn[x]) {
+                int s = edges.s[edge];
+                if (edges.Internal(edge) && !dfn[s]) {
+                    f(low[s]);
                 }
-            } else if (inStack[v] && low[u] > dfn[v]) {
-                lastDrop = edge;
-                low[u] = dfn[v];
             }
+        };
+
+        // degrees among the nodes left
+        auto& inDegree = trimInDegree_;
+        auto& outDegree = trimOutDegree_;
+        auto& removed = trimRemoved_;
+
+        Parallel::For(threadNum, 0, size, [&](long long i) {
+            removed[i].store(0, memory_order_relaxed);
+
+            int degree = 0;
+            forLeft(nodeList[i], [&](int) { degree++; });
+            outDegree[i].store(degree, memory_order_relaxed);
+
+            degree = 0;
+            forLeftIn(nodeList[i], [&](int) { degree++; });
+            inDegree[i].store(degree, memory_order_relaxed);
+        });
+
+        // peeling needs a first node to start from, usually the scc just lost a node or two and there is none
+        bool hasSeed = false;
+        for (int i=0;i<size;i++) {
+            hasSeed |= inDegree[i].load(memory_order_relaxed) == 0 || outDegree[i].load(memory_order_relaxed) == 0;
         }
 
-        if (lastDrop) { // before return, update the last dropping edge
-            lastDrop->needed = true;
+        if (!hasSeed) {
+            return;
         }
 
-        if (low[u] == dfn[u]) {
-            CreateSCC(u, dfsStack, inStack);
+        Parallel::Run(threadNum, [&](int id) {
+            auto& queue = trimQueue_[id]; // empty again when the thread is done
+            auto tryRemove = [&](int x) {
+                if (!removed[x].exchange(1)) {
+                    queue.emplace_back(x);
+                }
+            };
+
+            int rangeBegin = (long long) size * id / threadNum;
+            int rangeEnd = (long long) size * (id + 1) / threadNum;
+            for (int i=rangeBegin;i<rangeEnd;i++) {
+                if (inDegree[i].load() == 0 || outDegree[i].load() == 0) {
+                    tryRemove(i);
+                }
+            }
+
+            while (!queue.empty()) {
+                int x = queue.back();
+                queue.pop_back();
+
+                forLeft(nodeList[x], [&](int t) {
+                    if (inDegree[t].fetch_sub(1) == 1) {
+                        tryRemove(t);
+                    }
+                });
+
+                forLeftIn(nodeList[x], [&](int s) {
+                    if (outDegree[s].fetch_sub(1) == 1) {
+                        tryRemove(s);
+                    }
+                });
+            }
+        });
+
+        // trimmed nodes look finished to tarjan, so it never enters them and ignores the edges to them
+        for (int i=0;i<size;i++) {
+            if (removed[i].load(memory_order_relaxed)) {
+                int x = nodeList[i];
+                visited.emplace_back(x);
+                dfn[x] = low[x] = ++dfnNum;
+
+                for (int j=0;j<internalNum[x];j++) {
+                    edges.SetNeeded(G[x][j], false);
+                }
+            }
         }
     }
 
+    void Tarjan::DeletionSCC(int u, int v, DecOutput& output) {
+        auto& task = splitTask_;
+        task.sccID = Find(u);
+        task.edgeList.assign(1, {u, v});
+        task.result = SPLIT_KEPT;
+        ChooseSplit(task);
+
+        int necEdgeNum = necEdgeNumMap[task.sccID]; // not a reference, a new scc id may grow necEdgeNumMap
+        SplitSCC(task, args_, necEdgeNum, THREAD_NUM, output);
+        necEdgeNumMap[task.sccID] = necEdgeNum;
+        args_.Reset();
+        RecordSplit(task, output);
 
-    DecOutput Tarjan::DeletionSCC(int u, int v) {
-        DecOutput output;
-        int sccID = Find(u);
+        // since split, recalculate the necEdgeNum for each SCC
+        // in tarjan.cpp, it just sets to be 0. Then recalculation is always in ReduceGraph.cpp
+        if (output.newNode.size() > 1) {
+            for (auto i : output.newNode) {
+                necEdgeNumMap[i] = 0;
+            }
+        }
+    }
+
+    void Tarjan::SplitSCC(SplitTask& task, Args& args, int& necEdgeNum, int threadNum, DecOutput& output) {
+        int sccID = task.sccID;
         output.sccID = sccID;
+        output.newNode.clear();
 
-        // split scc
-        Args args(inStack_, dfn_, low_, visited_);
+        auto [u, v] = task.edgeList.front();
+        bool search = task.strategy == SPLIT_SEARCH;
+
+        // a path from u to v keeps the scc, the bfs stops at v so it only scans the region around the edge
+        if (search) {
+            if (TryBuildInternal(task.edgeList, args, necEdgeNum, task.result)) {
+                output.sccNodeList.clear();
+                return;
+            }
+            args.Reset();
+        }
+
+        // split scc, its node list trades places with the buffer of the output
         auto& dfn = args.dfn;
 
-        vector<int> sccNodeList = move(invSCCMap[sccID]);
+        auto& sccNodeList = output.sccNodeList;
+        sccNodeList.clear();
+        sccNodeList.swap(invSCCMap[sccID]);
 
         for (auto i : sccNodeList) {
             sccMap[i] = -1;
         }
         
-        // first round: to determine whether there is a path from u to v
+        // first round: to determine whether there is a path from u to v, only when the bfs could not tell
         bool redo = false;
         int prevLastDropNum = 0;
-        if (TryBuildInternal(u, v, args, redo, prevLastDropNum, 2*(sccNodeList.size()-1), necEdgeNumMap[Find(v)]) || redo) {
+        if (task.result == SPLIT_TRY && (TryBuildInternal(u, v, args, redo, prevLastDropNum, 2*(sccNodeList.size()-1), necEdgeNum) || redo)) {
             for (auto i : sccNodeList) {
                 sccMap[i] = sccID;
             }
             
-            invSCCMap[sccID] = move(sccNodeList);
+            invSCCMap[sccID].swap(sccNodeList); // the output gets the empty buffer back
 
-            return output;
+            return;
         }
 
-        // remaining round: just tarjan
+        // remaining round: trimming, then tarjan on the rest
+        TrimSplit(sccNodeList, args, threadNum);
+
         for (int i : sccNodeList) {
             if (!dfn[i]) {
                 BuildInternal(i, args);
@@ -365,26 +1302,28 @@ namespace MSCSC {
         }
 
         for (auto i : sccNodeList) {
-            invSCCMap[Find(i)].emplace_back(i);
-            output.newNode.emplace(Find(i));
+            int x = Find(i);
+            if (invSCCMap[x].empty()) { // every new scc starts with no nodes, so each is taken once
+                output.newNode.emplace_back(x);
+            }
+            invSCCMap[x].emplace_back(i);
         }
 
-        output.sccNodeList = move(sccNodeList);
-
         // since the scc needs split, we make the id of the biggest output scc node as the old scc id
         // it may reduce 2hop graph edge update
-        int maxID;
+        int maxIndex;
         int maxSize = 0;
 
-        for (auto i : output.newNode) {
-            if (sccMap[i] < maxSize) {
-                maxSize = sccMap[i];
-                maxID = i;
+        for (int i=0;i<(int) output.newNode.size();i++) {
+            if (sccMap[output.newNode[i]] < maxSize) {
+                maxSize = sccMap[output.newNode[i]];
+                maxIndex = i;
             }
         }
 
         // make sure the biggest output scc node is not a single node
         if (maxSize <= -2) {
+            int maxID = output.newNode[maxIndex];
             swap(invSCCMap[maxID], invSCCMap[sccID]);
             for (auto i : invSCCMap[sccID]) {
                 sccMap[i] = sccID;
@@ -392,98 +1331,264 @@ namespace MSCSC {
 
             sccMap[sccID] = sccMap[maxID];
             sccMap[maxID] = 0;
-            emptyNode.push(maxID);
+            FreeSCCID(maxID);
 
-            output.newNode.erase(maxID);
-            output.newNode.emplace(sccID);
+            output.newNode[maxIndex] = sccID;
         } else {
             sccMap[sccID] = 0;
-            emptyNode.push(sccID);
+            FreeSCCID(sccID);
         }
 
-        // since split, recalculate the necEdgeNum for each SCC
-        // in tarjan.cpp, it just sets to be 0. Then recalculation is always in ReduceGraph.cpp
-        for (auto i : output.newNode) {
-            necEdgeNumMap[i] = 0;
+        SumInternalEdge(output.newNode);
+        if (output.newNode.size() == 1) { // tarjan kept the scc whole, ReducedGraph does not count it again
+            necEdgeNum = NeededEdgeNum(sccID);
         }
+    }
+
+    void Tarjan::BatchDeletionSCC(int sccID, const vector<pair<int, int>>& edgeList, DecOutput& output) {
+        auto& task = splitTask_;
+        task.sccID = sccID;
+        task.edgeList.assign(edgeList.begin(), edgeList.end());
+        task.result = SPLIT_KEPT;
+        ChooseSplit(task);
+
+        int necEdgeNum = necEdgeNumMap[sccID]; // not a reference, a new scc id may grow necEdgeNumMap
+        BatchSplitSCC(task, args_, necEdgeNum, THREAD_NUM, output);
+        necEdgeNumMap[sccID] = necEdgeNum;
+        args_.Reset();
+        RecordSplit(task, output);
 
-        return output;
+        if (output.newNode.size() > 1) { // split, recalculated in ReducedGraph.cpp
+            for (auto i : output.newNode) {
+                necEdgeNumMap[i] = 0;
+            }
+        }
     }
 
-    DecOutput Tarjan::BatchDeletionSCC(int sccID) {
-        DecOutput output;
+    void Tarjan::BatchSplitSCC(SplitTask& task, Args& args, int& necEdgeNum, int threadNum, DecOutput& output) {
+        int sccID = task.sccID;
         output.sccID = sccID;
+        output.newNode.clear();
 
-        // split scc
-        Args args(inStack_, dfn_, low_, visited_);
+        // every deleted edge has an alternative path, no split
+        if (task.strategy == SPLIT_SEARCH) {
+            if (TryBuildInternal(task.edgeList, args, necEdgeNum, task.result)) {
+                output.sccNodeList.clear();
+                return;
+            }
+            args.Reset();
+        }
+
+        // split scc, its node list trades places with the buffer of the output
         auto& dfn = args.dfn;
 
-        vector<int> sccNodeList = move(invSCCMap[sccID]);
+        auto& sccNodeList = output.sccNodeList;
+        sccNodeList.clear();
+        sccNodeList.swap(invSCCMap[sccID]);
 
         for (auto i : sccNodeList) {
             sccMap[i] = -1;
         }
 
+        TrimSplit(sccNodeList, args, threadNum);
+
         for (auto i : sccNodeList) {
             if (!dfn[i]) {
                 BuildInternal(i, args);
             }
         }
 
-        unordered_set<int> outputSCC;
         for (auto i : sccNodeList) {
-            outputSCC.emplace(Find(i));
+            int x = Find(i);
+            if (invSCCMap[x].empty()) { // every new scc starts with no nodes, so each is taken once
+                output.newNode.emplace_back(x);
+            }
+            invSCCMap[x].emplace_back(i);
         }
 
-        if (outputSCC.size() == 1) { // not split
-            sccMap[*outputSCC.begin()] = 0;
-            emptyNode.emplace(*outputSCC.begin());
-
+        if (output.newNode.size() == 1) { // not split, the nodes go back to the old id
+            int id = output.newNode.front();
             for (auto i : sccNodeList) {
                 sccMap[i] = sccID;
             }
-            
-            invSCCMap[sccID] = move(sccNodeList);
-        } else {
-            for (auto i : sccNodeList) {
-                invSCCMap[Find(i)].emplace_back(i);
-                output.newNode.emplace(Find(i));
+
+            invSCCMap[sccID].swap(invSCCMap[id]);
+            sccMap[id] = 0;
+            FreeSCCID(id);
+
+            output.newNode.clear();
+            sccNodeList.clear();
+            necEdgeNum = NeededEdgeNum(sccID); // ReducedGraph does not count it again
+            return;
+        }
+
+        // since the scc needs split, we make the id of the biggest output scc node as the old scc id
+        // it may reduce 2hop graph edge update
+        int maxIndex;
+        int maxSize = 0;
+
+        for (int i=0;i<(int) output.newNode.size();i++) {
+            if (sccMap[output.newNode[i]] < maxSize) {
+                maxSize = sccMap[output.newNode[i]];
+                maxIndex = i;
+            }
+        }
+
+        // make sure the biggest output scc node is not a single node
+        if (maxSize <= -2) {
+            int maxID = output.newNode[maxIndex];
+            swap(invSCCMap[maxID], invSCCMap[sccID]);
+            for (auto i : invSCCMap[sccID]) {
+                sccMap[i] = sccID;
             }
 
-            output.sccNodeList = move(sccNodeList);
+            sccMap[sccID] = sccMap[maxID];
+            sccMap[maxID] = 0;
+            FreeSCCID(maxID);
 
-            // since the scc needs split, we make the id of the biggest output scc node as the old scc id
-            // it may reduce 2hop graph edge update
-            int maxID;
-            int maxSize = 0;
+            output.newNode[maxIndex] = sccID;
+        } else {
+            sccMap[sccID] = 0;
+            FreeSCCID(sccID);
+        }
 
-            for (auto i : output.newNode) {
-                if (sccMap[i] < maxSize) {
-                    maxSize = sccMap[i];
-                    maxID = i;
+        SumInternalEdge(output.newNode);
+    }
+
+    void Tarjan::ParallelDeletionSCC(vector<SplitTask>& taskList, vector<DecOutput>& outputList) {
+        if (outputList.size() < taskList.size()) {
+            outputList.resize(taskList.size());
+        }
+
+        int idNum = 0;
+        for (int i=0;i<(int) taskList.size();i++) {
+            ChooseSplit(taskList[i]);
+            idNum += -sccMap[taskList[i].sccID] / 2;
+        }
+
+        // a split takes at most one new id per two nodes; growing the pool inside the threads would move sccMap under them
+        ReserveSCCID(idNum);
+
+        // necEdgeNumMap does not grow while the threads run, each one only gets the value of its own scc
+        vector<int*> necEdgeNumList(taskList.size(), nullptr);
+        for (int i=0;i<(int) taskList.size();i++) {
+            necEdgeNumList[i] = &necEdgeNumMap[taskList[i].sccID];
+        }
+
+        // the sccs share no nodes, so the node indexed scratch arrays can be shared; only the visited list is per thread
+        atomic<int> nextTask(0);
+        int threadNum = min<int>(THREAD_NUM, taskList.size());
+
+        Parallel::Run(threadNum, [&](int) {
+            vector<int> visited;
+            Args args(inStack_, dfn_, low_, visited);
+
+            for (int i=nextTask++;i<(int) taskList.size();i=nextTask++) {
+                auto& task = taskList[i];
+
+                if (task.edgeList.size() == 1) {
+                    SplitSCC(task, args, *necEdgeNumList[i], 1, outputList[i]);
+                } else {
+                    BatchSplitSCC(task, args, *necEdgeNumList[i], 1, outputList[i]);
+                }
+                args.Reset();
+            }
+        });
+
+        for (int i=0;i<(int) taskList.size();i++) {
+            RecordSplit(taskList[i], outputList[i]);
+
+            if (outputList[i].newNode.size() > 1) { // split, recalculated in ReducedGraph.cpp
+                for (auto j : outputList[i].newNode) {
+                    necEdgeNumMap[j] = 0;
                 }
             }
+        }
+    }
+
+    void Tarjan::ChooseSplit(SplitTask& task) {
+        // the bfs costs little when it finds the paths and up to about 2 * |scc| edges when it does not,
+        // tarjan costs every internal edge; so search unless the search is cheap to skip or likely to fail
+        if (internalEdgeNum[task.sccID] < INTERNAL_EDGE_THRESHOLD) {
+            task.strategy = SPLIT_FULL_SMALL;
+            return;
+        }
 
-            // make sure the biggest output scc node is not a single node
-            if (maxSize <= -2) {
-                swap(invSCCMap[maxID], invSCCMap[sccID]);
-                for (auto i : invSCCMap[sccID]) {
-                    sccMap[i] = sccID;
+        // u without an internal out-edge or v without an internal in-edge is cut off, O(indeg v) over GIn
+        for (auto [u, v] : task.edgeList) {
+            bool reached = false;
+            for (auto edge : GIn[v]) {
+                if (edges.Internal(edge)) {
+                    reached = true;
+                    break;
                 }
+            }
+
+            if (!internalNum[u] || !reached) {
+                task.strategy = SPLIT_FULL_PROBE;
+                return;
+            }
+        }
 
-                sccMap[sccID] = sccMap[maxID];
-                sccMap[maxID] = 0;
-                emptyNode.push(maxID);
+        // each deleted edge splits the scc with probability splitRate
+        if (1 - pow(1 - splitRate, task.edgeList.size()) >= SPLIT_FULL_RATE) {
+            task.strategy = SPLIT_FULL_HISTORY;
+            return;
+        }
 
-                output.newNode.erase(maxID);
-                output.newNode.emplace(sccID);
+        task.strategy = SPLIT_SEARCH;
+    }
+
+    void Tarjan::RecordSplit(const SplitTask& task, const DecOutput& output) {
+        splitStrategyNum[task.strategy]++;
+        if (task.strategy == SPLIT_SEARCH) {
+            splitResultNum[task.result]++;
+        }
+
+        // small sccs and probed splits say nothing about the rest
+        if (task.strategy == SPLIT_SEARCH || task.strategy == SPLIT_FULL_HISTORY) {
+            if (output.newNode.size() > 1) { // one deleted edge at least split it
+                splitRate += SPLIT_RATE_WEIGHT * (1 - splitRate);
             } else {
-                sccMap[sccID] = 0;
-                emptyNode.push(sccID);
+                splitRate *= pow(1 - SPLIT_RATE_WEIGHT, task.edgeList.size());
             }
         }
+    }
+
+    int Tarjan::NewSCCID() {
+        lock_guard<mutex> lock(sccIDMutex);
+        if (emptyNode.empty()) { // doubling keeps it amortized O(1)
+            GrowSCCID(max(extendN, 1));
+        }
 
-        return output;
+        int id = emptyNode.back();
+        emptyNode.pop_back();
+        return id;
+    }
+
+    void Tarjan::FreeSCCID(int id) {
+        lock_guard<mutex> lock(sccIDMutex);
+        emptyNode.emplace_back(id);
+    }
+
+    void Tarjan::ReserveSCCID(int num) {
+        lock_guard<mutex> lock(sccIDMutex);
+        if ((int) emptyNode.size() < num) {
+            GrowSCCID(max<int>(num - emptyNode.size(), extendN));
+        }
+    }
+
+    void Tarjan::GrowSCCID(int num) {
+        int first = n + 1 + extendN;
+        extendN += num;
+        sccMap.resize(n+1+extendN, 0);
+        invSCCMap.resize(n+1+extendN);
+        internalEdgeNum.resize(n+1+extendN, 0);
+        necEdgeNumMap.resize(n+1+extendN, 0);
+
+        for (int id=n+extendN;id>=first;id--) { // the smallest id on top
+            emptyNode.emplace_back(id);
+        }
     }
 
     int Tarjan::Find(int u) {
@@ -494,51 +1599,417 @@ namespace MSCSC {
         return Find(u) == Find(v);
     }
 
-    EdgeNode* Tarjan::EdgeInsertion(int u, int v) {
-        auto edge = new EdgeNode(u, v);
+    int Tarjan::EdgeInsertion(int u, int v) {
+        if (removedVertex[u] || removedVertex[v]) {
+            printf("vertex %d is removed\n", removedVertex[u] ? u : v);
+            exit(30);
+        }
+
+        auto edge = edges.New(u, v);
         G[u].emplace_back(edge);
+        edges.inIndex[edge] = GIn[v].size();
+        GIn[v].emplace_back(edge);
+        m++;
+
+        auto it = edgeIndex.find(u);
+        if (it != edgeIndex.end()) {
+            it->second[v] = G[u].size() - 1;
+        }
 
         return edge;
     }
 
-    EdgeNode* Tarjan::EdgeRemove(int u, int v) {
-        int index;
-        for (index=0;index<G[u].size();index++) {
-            if (G[u][index]->t == v) {
-                break;
+    void Tarjan::EdgeRelease(int edge) {
+        edges.Delete(edge);
+    }
+
+    int Tarjan::EdgePosition(int u, int v) {
+        auto& edgeList = G[u];
+
+        if (edgeList.size() > EDGE_INDEX_THRESHOLD) { // high out-degree node, look up in its index (built on first use)
+            auto& nodeIndex = edgeIndex[u];
+            if (nodeIndex.empty()) {
+                nodeIndex.reserve(edgeList.size());
+                for (int i=0;i<(int) edgeList.size();i++) {
+                    nodeIndex[edges.t[edgeList[i]]] = i;
+                }
             }
+
+            return nodeIndex[v];
+        }
+
+        edgeIndex.erase(u); // the node has shrunk below the threshold
+        for (int i=0;i<(int) edgeList.size();i++) {
+            if (edges.t[edgeList[i]] == v) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    void Tarjan::SwapEdge(int u, int i, int j) {
+        if (i == j) {
+            return;
+        }
+
+        auto& edgeList = G[u];
+        swap(edgeList[i], edgeList[j]);
+
+        auto it = edgeIndex.find(u);
+        if (it != edgeIndex.end()) {
+            it->second[edges.t[edgeList[i]]] = i;
+            it->second[edges.t[edgeList[j]]] = j;
+        }
+    }
+
+    int Tarjan::EdgeRemove(int u, int v) {
+        auto& edgeList = G[u];
+        int index = EdgePosition(u, v);
+
+        if (index < internalNum[u]) { // move it to the end of the internal segment first
+            internalEdgeNum[Find(u)]--;
+            internalNum[u]--;
+            SwapEdge(u, index, internalNum[u]);
+            index = internalNum[u];
+        }
+
+        // swap with the last edge instead of shifting
+        SwapEdge(u, index, edgeList.size() - 1);
+        auto edge = edgeList.back();
+        edgeList.pop_back();
+        m--;
+
+        auto& inList = GIn[v]; // swap with the last one too
+        auto last = inList.back();
+        inList[edges.inIndex[edge]] = last;
+        edges.inIndex[last] = edges.inIndex[edge];
+        inList.pop_back();
+
+        auto it = edgeIndex.find(u);
+        if (it != edgeIndex.end()) {
+            it->second.erase(v);
         }
-        auto edge = G[u][index];
-        G[u].erase(G[u].begin() + index);
 
         return edge;
     }
 
+    void Tarjan::SetInternal(int edge, bool internal) {
+        if (edges.Internal(edge) != internal) {
+            int u = edges.s[edge];
+            SetInternalAt(u, EdgePosition(u, edges.t[edge]), internal);
+        }
+    }
+
+    void Tarjan::SetInternalAt(int u, int index, bool internal) {
+        auto edge = G[u][index];
+        if (edges.Internal(edge) == internal) {
+            return;
+        }
+
+        edges.SetInternal(edge, internal);
+        internalEdgeNum[Find(u)] += internal ? 1 : -1;
+        if (internal) { // the first external edge becomes the last internal one
+            SwapEdge(u, index, internalNum[u]);
+            internalNum[u]++;
+        } else {
+            internalNum[u]--;
+            SwapEdge(u, index, internalNum[u]);
+        }
+    }
+
+    void Tarjan::PartitionEdges(int u) {
+        auto& edgeList = G[u];
+        auto mid = partition(edgeList.begin(), edgeList.end(), [&](int edge) { return edges.Internal(edge); });
+        internalNum[u] = mid - edgeList.begin();
+        edgeIndex.erase(u); // positions changed, rebuilt on the next removal
+    }
+
+    void Tarjan::CountInternalEdge() {
+        internalEdgeNum.assign(sccMap.size(), 0);
+        for (int u=0;u<=n;u++) {
+            internalEdgeNum[Find(u)] += internalNum[u];
+        }
+    }
+
+    void Tarjan::SumInternalEdge(const vector<int>& idList) {
+        for (auto id : idList) {
+            internalEdgeNum[id] = 0;
+            for (auto i : invSCCMap[id]) {
+                internalEdgeNum[id] += internalNum[i];
+            }
+        }
+    }
+
+    int Tarjan::NeededEdgeNum(int sccID) {
+        int necEdgeNum = 0;
+        for (auto i : invSCCMap[sccID]) {
+            for (int j=0;j<internalNum[i];j++) {
+                necEdgeNum += edges.Needed(G[i][j]);
+            }
+        }
+        return necEdgeNum;
+    }
+
+    int Tarjan::AddVertex() {
+        if (emptyVertex.empty()) { // doubling keeps it amortized O(1)
+            GrowVertex(n + 1);
+        }
+
+        int u = emptyVertex.back();
+        emptyVertex.pop_back();
+        removedVertex[u] = 0;
+        return u;
+    }
+
+    void Tarjan::RemoveVertex(int u) {
+        if (removedVertex[u]) {
+            printf("vertex %d is already removed\n", u);
+            exit(30);
+        }
+
+        if (!G[u].empty() || !GIn[u].empty() || sccMap[u] != -1) {
+            printf("vertex %d still has edges\n", u);
+            exit(30);
+        }
+
+        emptyVertex.emplace_back(u);
+        removedVertex[u] = 1;
+    }
+
+    void Tarjan::GrowVertex(int num) {
+        // the scc ids follow the vertices, so every id x > n becomes x + num
+        int newN = n + num;
+        auto shift = [&](int x) { return x > n ? x + num : x; };
+
+        vector<int> newSCCMap(newN+1+extendN, 0);
+        vector<vector<int>> newInvSCCMap(newN+1+extendN);
+        vector<int> newInternalEdgeNum(newN+1+extendN, 0);
+        vector<int> newNecEdgeNumMap(newN+1+extendN, 0);
+        for (int i=0;i<(int) sccMap.size();i++) {
+            newSCCMap[shift(i)] = sccMap[i] > 0 ? shift(sccMap[i]) : sccMap[i];
+            newInvSCCMap[shift(i)] = move(invSCCMap[i]);
+            newInternalEdgeNum[shift(i)] = internalEdgeNum[i];
+            newNecEdgeNumMap[shift(i)] = necEdgeNumMap[i];
+        }
+        sccMap = move(newSCCMap);
+        invSCCMap = move(newInvSCCMap);
+        internalEdgeNum = move(newInternalEdgeNum);
+        necEdgeNumMap = move(newNecEdgeNumMap);
+
+        for (auto& id : emptyNode) {
+            id = shift(id);
+        }
+
+        removedVertex.resize(newN+1, 0);
+        for (int u=newN;u>n;u--) { // the smallest slot on top
+            sccMap[u] = -1;
+            removedVertex[u] = 1;
+            invSCCMap[u].assign(1, u); // a single node scc holds itself
+            emptyVertex.emplace_back(u);
+        }
+
+        n = newN;
+        G.resize(n+1);
+        GIn.resize(n+1);
+        internalNum.resize(n+1, 0);
+        ResizeScratch();
+    }
+
     bool Tarjan::QueryBFS(int u, int v) {
-        if (u == v) return true;
+        int target = Find(v);
+        if (Find(u) == target) { // same scc, u == v included
+            return true;
+        }
 
-        vector<int> visited(n+1, 0);
-        visited[u] = 1;
+        unsigned epoch = NextEpoch();
+        auto& frontier = queryFrontier_;
+        auto& next = queryNext_;
+
+        frontier.assign(1, u);
+        visitStamp_[u] = epoch;
+
+        bool bottomUp = false;
+        unsigned long long frontierEdge = G[u].size();
+        size_t frontierSize = 1;
+
+        // reaching any node of v's scc is enough
+        auto visit = [&](int x) {
+            visitStamp_[x] = epoch;
+            frontierSize++;
+            frontierEdge += G[x].size();
+            return Find(x) == target;
+        };
+
+        while (frontierSize) {
+            // bottom-up pays off once the frontier holds a large part of the edges
+            if (!bottomUp && frontierEdge > m / QUERY_BOTTOM_UP_ALPHA) {
+                frontierBit_.assign((n + 64) / 64, 0);
+                for (int x : frontier) {
+                    frontierBit_[x >> 6] |= 1ULL << (x & 63);
+                }
+                bottomUp = true;
+            } else if (bottomUp && frontierSize < (size_t) (n + 1) / QUERY_TOP_DOWN_BETA) {
+                frontier.clear();
+                for (int i=0;i<(int) frontierBit_.size();i++) {
+                    for (auto word=frontierBit_[i];word;word&=word-1) {
+                        frontier.emplace_back(i * 64 + __builtin_ctzll(word));
+                    }
+                }
+                bottomUp = false;
+            }
 
-        set<int> q = {u};
-        while (!q.empty()) {
-            set<int> tmpQ;
-            for (int i : q) {
-                for (auto j : G[i]) {
-                    if (j->t == v) return true;
+            frontierSize = 0;
+            frontierEdge = 0;
+
+            if (!bottomUp) { // top-down, from the frontier along out-edges
+                next.clear();
+                for (int x : frontier) {
+                    for (auto edge : G[x]) {
+                        int y = edges.t[edge];
+                        if (visitStamp_[y] != epoch) {
+                            if (visit(y)) {
+                                return true;
+                            }
+                            next.emplace_back(y);
+                        }
+                    }
+                }
+                frontier.swap(next);
+            } else { // bottom-up, every unvisited node looks for an in-edge from the frontier
+                nextBit_.assign(frontierBit_.size(), 0);
+                for (int y=0;y<=n;y++) {
+                    if (visitStamp_[y] == epoch) {
+                        continue;
+                    }
 
-                    if (visited[j->t] == 0) {
-                        visited[j->t] = 1;
-                        tmpQ.emplace(j->t);
+                    for (auto edge : GIn[y]) {
+                        int x = edges.s[edge];
+                        if (frontierBit_[x >> 6] >> (x & 63) & 1) {
+                            if (visit(y)) {
+                                return true;
+                            }
+                            nextBit_[y >> 6] |= 1ULL << (y & 63);
+                            break;
+                        }
                     }
                 }
+                frontierBit_.swap(nextBit_);
             }
-            q = move(tmpQ);
         }
 
         return false;
     }
 
+    vector<bool> Tarjan::QueryBatch(const vector<pair<int, int>>& queryList) {
+        vector<bool> result(queryList.size(), false);
+
+        // queries across sccs, grouped by source
+        auto& pending = batchPending_;
+        pending.clear();
+        for (int i=0;i<(int) queryList.size();i++) {
+            if (Find(queryList[i].first) == Find(queryList[i].second)) {
+                result[i] = true;
+            } else {
+                pending.emplace_back(i);
+            }
+        }
+        sort(pending.begin(), pending.end(), [&](int a, int b) {
+            return queryList[a].first < queryList[b].first;
+        });
+
+        // the masks stay zero between calls, only the touched entries are cleared
+        auto& touched = batchTouched_;
+        auto& frontier = batchFrontier_;
+        auto& next = batchNextFrontier_;
+        auto& queryBit = batchQueryBit_;
+
+        // one traversal for up to 64 sources, bit b of a node's mask: reached from the b-th source
+        for (int begin=0;begin<(int) pending.size();) {
+            int end = begin;
+            int sourceNum = 0;
+            queryBit.clear();
+
+            while (end < (int) pending.size()) {
+                int source = queryList[pending[end]].first;
+                if (end == begin || source != queryList[pending[end-1]].first) {
+                    if (sourceNum == 64) {
+                        break;
+                    }
+
+                    auto bit = 1ULL << sourceNum++;
+                    batchSeen_[source] = batchVisit_[source] = bit;
+                    touched.emplace_back(source);
+                    frontier.emplace_back(source);
+                }
+                queryBit.emplace_back(1ULL << (sourceNum - 1));
+                end++;
+            }
+
+            auto unanswered = [&]() {
+                for (int i=begin;i<end;i++) {
+                    if (!(batchSeen_[queryList[pending[i]].second] & queryBit[i-begin])) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+
+            while (!frontier.empty() && unanswered()) {
+                next.clear();
+                for (int x : frontier) {
+                    auto bits = batchVisit_[x];
+                    batchVisit_[x] = 0;
+
+                    for (auto edge : G[x]) {
+                        int y = edges.t[edge];
+                        auto newBits = bits & ~batchSeen_[y];
+                        if (!newBits) {
+                            continue;
+                        }
+
+                        if (!batchSeen_[y]) {
+                            touched.emplace_back(y);
+                        }
+                        if (!batchNext_[y]) {
+                            next.emplace_back(y);
+                        }
+                        batchSeen_[y] |= newBits;
+                        batchNext_[y] |= newBits;
+                    }
+                }
+
+                for (int y : next) {
+                    batchVisit_[y] = batchNext_[y];
+                    batchNext_[y] = 0;
+                }
+                frontier.swap(next);
+            }
+
+            for (int i=begin;i<end;i++) {
+                result[pending[i]] = batchSeen_[queryList[pending[i]].second] & queryBit[i-begin];
+            }
+
+            for (int x : touched) {
+                batchSeen_[x] = batchVisit_[x] = batchNext_[x] = 0;
+            }
+            touched.clear();
+            frontier.clear();
+
+            begin = end;
+        }
+
+        return result;
+    }
+
+    unsigned Tarjan::NextEpoch() {
+        if (++visitEpoch == 0) { // wrapped around, old stamps could match again
+            fill(visitStamp_.begin(), visitStamp_.end(), 0);
+            visitEpoch = 1;
+        }
+        return visitEpoch;
+    }
+
     void Tarjan::Info() {
         set<int> sccSet;
         set<int> nonSingleSccSet;
@@ -549,24 +2020,23 @@ namespace MSCSC {
             }
         }
 
-        unsigned long long nowM = 0;
+        // one pass over the flags of the store, removed edges have none
         unsigned long long sccEdge = 0;
         unsigned long long necEdgeNum = 0;
 
-        for (auto& edgeList : G) {
-            for (auto edge : edgeList) {
-                if (Find(edge->s) != Find(edge->t)) {
-                    nowM++;
-                } else {
-                    sccEdge++;
-                    necEdgeNum += edge->needed;
-                }
-            }
+        for (auto flag : edges.flag) {
+            sccEdge += (flag & EDGE_INTERNAL) != 0;
+            necEdgeNum += flag == (EDGE_NEEDED | EDGE_INTERNAL);
         }
 
+        unsigned long long nowM = edges.flag.size() - edges.freeEdge.size() - sccEdge;
+
         printf("\nn: %d m: %llu\n", n, m);
         printf("nowN: %ld, nowM: %llu\n", sccSet.size(), nowM);
         printf("non-single-scc num: %ld, necEdgeNum: %llu, total scc edge: %llu\n", nonSingleSccSet.size(), necEdgeNum, sccEdge);
+        printf("split search: %lld (kept: %lld, cut: %lld, try: %lld, redo: %lld), full small: %lld, full probe: %lld, full history: %lld, split rate: %.3f\n",
+            splitStrategyNum[SPLIT_SEARCH], splitResultNum[SPLIT_KEPT], splitResultNum[SPLIT_CUT], splitResultNum[SPLIT_TRY], splitResultNum[SPLIT_REDO],
+            splitStrategyNum[SPLIT_FULL_SMALL], splitStrategyNum[SPLIT_FULL_PROBE], splitStrategyNum[SPLIT_FULL_HISTORY], splitRate);
     }
 
 }
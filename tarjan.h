@@ -1,24 +1,54 @@
 #pragma once
 
+#include <cstdio>
 #include <set>
 #include <vector>
 #include <map>
 #include <queue>
+#include <mutex>
+#include <atomic>
 #include <stack>
 #include <unordered_set>
 #include <unordered_map>
 
 #include "config.h"
 #include "timer.h"
+#include "AdjacencyMap.h"
 
 namespace MSCSC {
     using namespace std;
 
+    // frame of the iterative DFS over G
+    struct EdgeFrame {
+        int u;
+        int index; // next edge in G[u]
+        int lastDrop; // -1 if none
+    };
+
+    // entry of the bfs queue of TryBuildInternal
+    struct PathFrame {
+        int u;
+        int parent; // position in the bfs queue
+        int edge; // from the parent, -1 at the root
+    };
+
+    // frame of the iterative DFS over the reduced graph
+    struct SuperEdgeFrame {
+        int u;
+        AdjacencyMap::iterator it; // current edge in GOut[u]
+        SuperEdge* lastDrop;
+        bool result;
+    };
+
     class Args {
     public:
         Args(vector<int>& inStack_, vector<int>& dfn_, vector<int>& low_, vector<int>& visited_): inStack(inStack_), dfn(dfn_), low(low_), visited(visited_), dfnNum(0) {}
 
         ~Args() {
+            Reset();
+        }
+
+        void Reset() { // also makes it ready for the next traversal, the stacks keep their capacity
             for (int i : visited) {
                 inStack[i] = 0;
                 dfn[i] = 0;
@@ -26,29 +56,64 @@ namespace MSCSC {
             }
 
             visited.clear();
+            dfnNum = 0;
+            dfsStack.clear();
+            edgeFrame.clear();
+            superEdgeFrame.clear();
         }
 
         int dfnNum;
-        stack<int> dfsStack;
+        vector<int> dfsStack;
+        vector<EdgeFrame> edgeFrame; // explicit DFS stack, so no traversal depends on the thread stack size
+        vector<SuperEdgeFrame> superEdgeFrame;
+        vector<PathFrame> pathQueue;
         vector<int>& inStack;
         vector<int>& dfn;
         vector<int>& low;
         vector<int>& visited;
     };
 
+    // how a deletion of needed edges in one scc is decided, chosen by Tarjan::ChooseSplit
+    enum SplitStrategy {
+        SPLIT_SEARCH, // bfs from u to v for every deleted edge, tarjan if one fails
+        SPLIT_FULL_SMALL, // tarjan right away: fewer than INTERNAL_EDGE_THRESHOLD internal edges
+        SPLIT_FULL_PROBE, // tarjan right away: some u has no internal out-edge or some v no internal in-edge left, so it splits
+        SPLIT_FULL_HISTORY, // tarjan right away: with the recent split rate, a split is likely
+        SPLIT_STRATEGY_NUM,
+    };
+
+    // how SPLIT_SEARCH ended
+    enum SplitResult {
+        SPLIT_KEPT, // every deleted edge re-routed
+        SPLIT_CUT, // some v is cut off from u, tarjan
+        SPLIT_TRY, // out of budget, the dfs try for a single edge and tarjan if needed
+        SPLIT_REDO, // every deleted edge re-routed, but over 2 * (|scc| - 1) needed edges, tarjan
+        SPLIT_RESULT_NUM,
+    };
+
+    // one scc of a batch deletion: split by DeletionSCC(u, v) for one deleted needed edge, otherwise by BatchDeletionSCC
+    struct SplitTask {
+        int sccID;
+        vector<pair<int, int>> edgeList; // deleted needed edges
+        SplitStrategy strategy = SPLIT_SEARCH;
+        SplitResult result = SPLIT_KEPT;
+    };
+
     class TwoHop;
 
     class Tarjan {
     public:
+        Tarjan() = default;
         Tarjan(string filePath);
 
         // tarjan
         void Construction();
+        void ParallelConstruction(); // trimming + one forward-backward search with THREAD_NUM threads, then one sequential tarjan per remaining part
         void Build(int u, Args& args); 
-        void CreateSCC(int root, stack<int>& dfsStack, vector<int>& inStack);
+        void CreateSCC(int root, vector<int>& dfsStack, vector<int>& inStack);
 
         // scc merge
-        void InsertionSCC(EdgeNode* newEdge, IncOutput& output); // return nodes whose sccMap value changes
+        void InsertionSCC(int newEdge, IncOutput& output); // return nodes whose sccMap value changes
         void InsertionSCC(IncOutput& output); // return nodes whose sccMap value changes
         void InsertionManageSCCNode(IncOutput& output);
 
@@ -57,11 +122,13 @@ namespace MSCSC {
 
         // scc split
         bool TryBuildInternal(int u, int target, Args& args, bool& redo, int& prevLastDropNum, int threshold, int& necEdgeNum); // return whether there is an alternative path
+        bool TryBuildInternal(const vector<pair<int, int>>& edgeList, Args& args, int& necEdgeNum, SplitResult& result); // return whether every deleted (u, v) has an alternative path within the needed edge bound, result: why not
         void BuildInternal(int u, Args& args);
-        DecOutput DeletionSCC(int u, int v); // return nodes whose sccMap value changes
+        void DeletionSCC(int u, int v, DecOutput& output); // output: nodes whose sccMap value changes
 
         // batch deletion
-        DecOutput BatchDeletionSCC(int sccID);
+        void BatchDeletionSCC(int sccID, const vector<pair<int, int>>& edgeList, DecOutput& output); // edgeList: the deleted needed edges
+        void ParallelDeletionSCC(vector<SplitTask>& taskList, vector<DecOutput>& outputList); // split independent sccs with THREAD_NUM threads, outputList only grows
 
         // find the scc id of this node u
         int Find(int u);
@@ -70,31 +137,98 @@ namespace MSCSC {
         bool InSameSCC(int u, int v);
 
         // just update graph edge
-        EdgeNode* EdgeInsertion(int u, int v); 
-        EdgeNode* EdgeRemove(int u, int v);
+        int EdgeInsertion(int u, int v); 
+        int EdgeRemove(int u, int v);
+        void EdgeRelease(int edge); // give a removed edge back to the store
+
+        // internal flag of an edge, moving it between the internal and the external segment of G[u]
+        void SetInternal(int edge, bool internal);
+        void SetInternalAt(int u, int index, bool internal); // the edge at G[u][index]
+        void PartitionEdges(int u); // regroup G[u] after its flags were set directly
+        void CountInternalEdge(); // internalEdgeNum from scratch, after PartitionEdges
+
+        // vertex slots
+        int AddVertex(); // an isolated vertex, reusing a removed slot; when none is left n doubles and every scc id moves up
+        void RemoveVertex(int u); // u must have no edges left and not be removed already, its slot goes back to the pool
 
         // original graph query
-        bool QueryBFS(int u, int v);
+        bool QueryBFS(int u, int v); // direction-optimizing bfs, stops at the first node of v's scc
+        vector<bool> QueryBatch(const vector<pair<int, int>>& queryList); // bit-parallel bfs, 64 sources per traversal
 
         // status
         void Info();
 
+        // write the current graph in the binary CSR format
+        void SaveBinary(string filePath);
+
+        // checkpoint: graph, flags and scc nodes
+        void Serialize(FILE* file);
+        void Deserialize(FILE* file);
+
     private:
         // file
-        void Load(string filePath);
+        void Load(string filePath); // detect the format and load
+        void LoadText(const char* buffer, size_t fileSize);
+        void LoadBinary(const char* buffer, size_t fileSize);
+
+        void ResizeScratch();
+        void BuildIn(); // GIn from G
+
+        // position in G[u]
+        int EdgePosition(int u, int v);
+        void SwapEdge(int u, int i, int j); // keeps edgeIndex in sync
+
+        // query
+        unsigned NextEpoch(); // visited iff visitStamp_[u] == the returned epoch
+
+        // scc id pool, safe to call from several threads
+        int NewSCCID(); // grows the id space when the pool is empty, so threads sharing sccMap must reserve first
+        void FreeSCCID(int id);
+        void ReserveSCCID(int num); // at least num unused ids without growing
+        void GrowSCCID(int num); // append num ids, the caller holds sccIDMutex
+        void GrowVertex(int num); // num more vertex slots, the scc ids move up by num
+
+        int NeededEdgeNum(int sccID); // needed internal edges of the scc, counted
+        void SumInternalEdge(const vector<int>& idList); // internalEdgeNum of the sccs a split made, from internalNum
+
+        // scc split, only touch the nodes of this scc and the ids from the pool
+        void SplitSCC(SplitTask& task, Args& args, int& necEdgeNum, int threadNum, DecOutput& output); // one deleted edge
+        void BatchSplitSCC(SplitTask& task, Args& args, int& necEdgeNum, int threadNum, DecOutput& output);
+
+        // split strategy selector, both run outside the split threads
+        void ChooseSplit(SplitTask& task); // from the scc size, its internal edges and the recent split rate
+        void RecordSplit(const SplitTask& task, const DecOutput& output); // counters and split rate
+        void TrimSplit(const vector<int>& sccNodeList, Args& args, int threadNum); // peel single node sccs off the nodes tarjan has not visited
+
+        void BuildFrom(int u, Args& args, bool internalOnly); // iterative tarjan, only on internal edges if internalOnly
+        void BuildPart(const vector<char>& part, char label, vector<int>& dfn, vector<int>& low, vector<char>& inStack, vector<vector<int>>& sccList); // tarjan on nodes with part[u] == label, scc ids are not given
 
     public:
-        vector<vector<EdgeNode*>> G; // GOut, outgoing edges; we can split edge into G_partition, G_others
+        vector<vector<int>> G; // GOut, outgoing edges as indices into edges; the internal edges first, then the external ones
+        vector<int> internalNum; // G[u][0, internalNum[u]) are the internal edges of u
+        vector<vector<int>> GIn; // incoming edges as indices into edges, in no order; the only reverse graph, also of ParallelConstruction and TrimSplit
+        vector<int> internalEdgeNum; // indexed like sccMap: internal edges of the scc, the sum of internalNum over its nodes
+        EdgeStore edges; // every edge in G
 
         unsigned long long m;
         int n;
-        int extendN; // extendN = (n + 2) / 2; since we always choose a new node u (>n) as a new scc node
+        int extendN; // scc node ids are (n, n + extendN], (n + 2) / 2 at first and doubled whenever the pool runs out
 
         vector<vector<int>> invSCCMap; // to save the nodes in a scc node
 
-        unordered_map<int, int> necEdgeNumMap; // scc_id -> necEdgeNum.  This one is first calculated in ReducedGraph, as it needs to scan all edges
+        vector<int> necEdgeNumMap; // indexed like sccMap: necEdgeNum of the scc.  This one is first calculated in ReducedGraph, as it needs to scan all edges
+
+        // decisions of the split strategy selector, printed by Info
+        long long splitStrategyNum[SPLIT_STRATEGY_NUM] = {};
+        long long splitResultNum[SPLIT_RESULT_NUM] = {};
+        double splitRate = 0; // moving average over deleted needed edges of "the scc split"
     private:
-        priority_queue<int, vector<int>, greater<int>> emptyNode; // unused scc node pool
+        unordered_map<int, unordered_map<int, int>> edgeIndex; // u -> (v -> position in G[u]), only for nodes with more than EDGE_INDEX_THRESHOLD out-edges
+
+        vector<int> emptyNode; // unused scc node ids, used as a stack
+        vector<int> emptyVertex; // removed vertex slots, used as a stack
+        vector<char> removedVertex; // removedVertex[u]: the slot of u is in emptyVertex, so it takes no edges
+        mutex sccIDMutex; // guards emptyNode
 
         vector<int> sccMap; // for single node u, sscMap[u] = -1; for scc sub-node, sccMap[u] = x where x > n
         
@@ -104,5 +238,32 @@ namespace MSCSC {
         vector<int> dfn_;
         vector<int> low_;
         vector<int> visited_;
+
+        // scratch of DeletionSCC and BatchDeletionSCC, kept so a deletion allocates no stacks
+        Args args_{inStack_, dfn_, low_, visited_};
+        SplitTask splitTask_;
+
+        // scratch of TrimSplit, only the split of a single deletion trims
+        vector<int> trimNode_;
+        vector<atomic<int>> trimInDegree_;
+        vector<atomic<int>> trimOutDegree_;
+        vector<atomic<char>> trimRemoved_;
+        vector<vector<int>> trimQueue_; // one per thread
+
+        // query scratch
+        vector<unsigned> visitStamp_;
+        unsigned visitEpoch = 0;
+        vector<int> queryFrontier_;
+        vector<int> queryNext_;
+        vector<unsigned long long> frontierBit_;
+        vector<unsigned long long> nextBit_;
+        vector<unsigned long long> batchSeen_;
+        vector<unsigned long long> batchVisit_;
+        vector<unsigned long long> batchNext_;
+        vector<int> batchPending_;
+        vector<int> batchTouched_; // the nodes whose masks are set, cleared after each traversal
+        vector<int> batchFrontier_;
+        vector<int> batchNextFrontier_;
+        vector<unsigned long long> batchQueryBit_;
     };
 }
\ No newline at end of file
@@ -1,11 +1,11 @@
 #include "timer.h"
 #include "graph.h"
+#include "UpdateReader.h"
 
 #include <random>
 #include <fstream>
 #include <algorithm>
 #include <string.h>
-#include <sys/resource.h>
 
 
 using namespace std;
@@ -18,16 +18,20 @@ vector<pair<int, int>> updateEdgeList;
 
 void LoadUpdate(string updateFilePath);
 
-void ShowPhysicalMemory();
+void StreamUpdate(MSCSC::Graph& g, string updateFilePath, int usePrune, int useIncOpt, int batchSize);
+
+void CheckBatchDeletion(MSCSC::Graph& g, int batchSize);
 
-void SetStackSize(int stackSize);
+void CheckVertexGrowth(MSCSC::Graph& g, string checkpointPath);
+
+void ShowPhysicalMemory();
 
 
 int main(int argc, char* argv[]) {
     int nextArg = 1;
     string filePath(argv[nextArg++]);
-    int stackSize = atoi(argv[nextArg++]);
-    int testUpdate = atoi(argv[nextArg++]); // 1/0
+    nextArg++; // stack size in GB, no longer needed since every traversal is iterative
+    int testUpdate = atoi(argv[nextArg++]); // 1: delete then insert the update edges   2: mixed update log   3: batch-delete the update edges and check the index   4: grow the vertex slots and check a checkpoint   0: no update
     int usePrune = atoi(argv[nextArg++]); // 1: use   0: not use
     int useIncOpt = atoi(argv[nextArg++]); // 1: use   0: not use
     int useBatch = atoi(argv[nextArg++]); // 1: use   0: not use
@@ -35,8 +39,6 @@ int main(int argc, char* argv[]) {
     int batchSize = -1;
     if (useBatch) batchSize = atoi(argv[nextArg++]);
 
-    SetStackSize(stackSize);
-
     MSCSC::Graph g(filePath);
 
     g.ConstructionTarjan();
@@ -46,8 +48,33 @@ int main(int argc, char* argv[]) {
 
     g.tarjan->Info();
 
+    // mixed update log, applied while it is being read
+    if (testUpdate == 2) {
+        string updateFilePath(argv[nextArg++]);
+        StreamUpdate(g, updateFilePath, usePrune, useIncOpt, batchSize);
+
+        g.tarjan->Info();
+
+        g.Info();
+    }
+
+    // consistency check of the batch deletion, exits with 1 on the first wrong answer
+    if (testUpdate == 3) {
+        string updateFilePath(argv[nextArg++]);
+        LoadUpdate(updateFilePath);
+        CheckBatchDeletion(g, batchSize);
+
+        g.Info();
+    }
+
+    // regression check of the vertex slots, the graph is example/vertex.txt
+    if (testUpdate == 4) {
+        string checkpointPath(argv[nextArg++]);
+        CheckVertexGrowth(g, checkpointPath);
+    }
+
     // update 
-    if (testUpdate) {
+    if (testUpdate == 1) {
         string updateFilePath(argv[nextArg++]);
         LoadUpdate(updateFilePath);
 
@@ -131,6 +158,143 @@ void LoadUpdate(string updateFilePath) {
     cout << "update num: " << updateEdgeList.size() << endl << endl;
 }
 
+void StreamUpdate(MSCSC::Graph& g, string updateFilePath, int usePrune, int useIncOpt, int batchSize) {
+    MSCSC::UpdateReader reader(updateFilePath);
+    UpdateOp update;
+    unsigned long long num = 0;
+
+    // consecutive updates of the same type are grouped when batch update is used
+    vector<pair<int, int>> tmpList;
+    int tmpType = UPDATE_INSERTION;
+    auto flush = [&]() {
+        if (tmpList.empty()) {
+            return;
+        }
+
+        if (tmpType == UPDATE_INSERTION) {
+            g.BatchInsertion(tmpList);
+        } else {
+            g.BatchDeletion(tmpList);
+        }
+        tmpList.clear();
+    };
+
+    myTimer.StartTimer("update");
+    while (reader.Next(update)) {
+        num++;
+
+        if (batchSize > 0) {
+            if ((int) tmpList.size() == batchSize || update.type != tmpType) {
+                flush();
+            }
+            tmpType = update.type;
+            tmpList.emplace_back(update.u, update.v);
+            continue;
+        }
+
+        if (update.type == UPDATE_INSERTION) {
+            if (useIncOpt) {
+                g.InsertionMinimum(update.u, update.v);
+            } else {
+                g.Insertion(update.u, update.v);
+            }
+        } else {
+            if (usePrune) {
+                g.Deletion(update.u, update.v);
+            } else {
+                g.DeletionWithoutPruningPower(update.u, update.v);
+            }
+        }
+    }
+    flush();
+    unsigned long long updateTime = myTimer.EndTimer("update");
+
+    cout << "update num: " << num << endl;
+    if (num) {
+        cout << endl << "avg update time: " << updateTime / num << endl;
+    }
+}
+
+void CheckBatchDeletion(MSCSC::Graph& g, int batchSize) {
+    if (batchSize <= 0) {
+        batchSize = updateEdgeList.size();
+    }
+
+    int n = g.tarjan->n;
+    uniform_int_distribution<int> node(1, n);
+    bool allPair = (long long) n * n <= 65536; // all pairs of a small graph, random ones otherwise
+
+    for (int i=0;i<(int) updateEdgeList.size();i+=batchSize) {
+        vector<pair<int, int>> tmpList(updateEdgeList.begin() + i, updateEdgeList.begin() + min(i + batchSize, (int) updateEdgeList.size()));
+        g.BatchDeletion(tmpList);
+
+        if (!g.reducedGraph->CheckLabel()) {
+            cout << "check failed: reachability label after batch " << i / batchSize << endl;
+            exit(1);
+        }
+
+        for (int k=0;k<(allPair ? n * n : 65536);k++) {
+            int u = allPair ? k / n + 1 : node(e);
+            int v = allPair ? k % n + 1 : node(e);
+            if (g.Reachable(u, v) != g.tarjan->QueryBFS(u, v)) {
+                cout << "check failed: Reachable(" << u << ", " << v << ") after batch " << i / batchSize << endl;
+                exit(1);
+            }
+        }
+    }
+
+    cout << "check passed: " << updateEdgeList.size() << " deletions" << endl;
+}
+
+void CheckVertexGrowth(MSCSC::Graph& g, string checkpointPath) {
+    auto cycle = [&](vector<int> nodeList) { // every edge among the nodes
+        for (auto u : nodeList) {
+            for (auto v : nodeList) {
+                if (u != v) {
+                    g.Insertion(u, v);
+                }
+            }
+        }
+    };
+
+    // a whole scc rebuilt by tarjan after AddVertex grew the vertex slots takes a new scc id and grows the id space
+    int last = g.tarjan->n;
+    vector<int> newVertex;
+    for (int i=0;i<4;i++) {
+        newVertex.emplace_back(g.AddVertex());
+    }
+    cycle({last, newVertex[0]});
+    cycle({newVertex[1], newVertex[2], newVertex[3]});
+
+    for (int i=0;i<2;i++) {
+        newVertex.emplace_back(g.AddVertex());
+    }
+    cycle({newVertex[4], newVertex[5]});
+
+    g.Deletion(newVertex[1], newVertex[2]);
+
+    if (g.tarjan->extendN != g.reducedGraph->extendN) {
+        cout << "check failed: scc id space of tarjan " << g.tarjan->extendN << ", reduced graph " << g.reducedGraph->extendN << endl;
+        exit(1);
+    }
+
+    g.Save(checkpointPath);
+    MSCSC::Graph restored;
+    restored.Load(checkpointPath);
+
+    int n = g.tarjan->n;
+    for (int u=1;u<=n;u++) {
+        for (int v=1;v<=n;v++) {
+            if (g.Reachable(u, v) != restored.Reachable(u, v)) {
+                cout << "check failed: Reachable(" << u << ", " << v << ") after Load" << endl;
+                exit(1);
+            }
+        }
+    }
+
+    cout << "check passed: " << n << " vertex slots" << endl;
+}
+
 void ShowPhysicalMemory() {
     FILE* file = fopen("/proc/self/status", "r");
     int result = -1;
@@ -154,18 +318,3 @@ void ShowPhysicalMemory() {
 
     printf("\n\nPhysical Memory: %d \n\n", result);
 }
-
-void SetStackSize(int stackSize) {
-    const rlim_t kStackSize = stackSize * 1024L * 1024L * 1024L;   // min stack size = ? Gb
-    struct rlimit rl;
-    int result = getrlimit(RLIMIT_STACK, &rl);
-    if (result == 0) {
-        if (rl.rlim_cur < kStackSize) {
-            rl.rlim_cur = kStackSize;
-            result = setrlimit(RLIMIT_STACK, &rl);
-            if (result != 0) {
-                fprintf(stderr, "setrlimit returned result = %d\n", result);
-            }
-        }
-    }
-}
\ No newline at end of file